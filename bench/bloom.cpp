@@ -0,0 +1,80 @@
+// find com e sem enable_filter() em cargas com 0%, 50%, 90% e 100% de
+// buscas por chaves ausentes, mais o custo do filtro no insert/del e a
+// memoria dele.
+//
+//   $ ./bench_bloom 10000000 5000000
+
+#include "../btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+static double ns_per_op(std::chrono::steady_clock::time_point t0, std::size_t ops) {
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / ops;
+}
+
+template<class K>
+void run(const char *name, std::size_t n, std::size_t queries) {
+	std::mt19937_64 rng(22);
+
+	// Chaves pares na arvore, impares ausentes.
+	std::vector<K> keys(n);
+	for (auto &k : keys)
+		k = (K)(rng() & ~1ull);
+	std::sort(keys.begin(), keys.end());
+
+	BTree<K> plain, filtered;
+	plain.bulk_load(keys.begin(), keys.end());
+	filtered.enable_filter();
+	filtered.bulk_load(keys.begin(), keys.end());
+
+	std::cout << name << " n=" << n << ", filtro com "
+		<< filtered.stats().filter_bytes / (double)n << " bytes/chave" << std::endl;
+
+	for (int miss : {0, 50, 90, 100}) {
+		std::vector<K> probes(queries);
+		for (auto &k : probes)
+			k = (int)(rng() % 100) < miss ? (K)(rng() | 1) : keys[rng() % n];
+
+		std::size_t found = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		for (auto &k : probes)
+			found += plain.find(k);
+		double plain_ns = ns_per_op(t0, queries);
+
+		t0 = std::chrono::steady_clock::now();
+		for (auto &k : probes)
+			found -= filtered.find(k);
+		double filtered_ns = ns_per_op(t0, queries);
+
+		std::cout << "  " << miss << "% ausentes: " << plain_ns << " -> " << filtered_ns
+			<< " ns/find" << (found ? " (divergiu!)" : "") << std::endl;
+	}
+
+	// insert/del de chaves novas: o filtro recebe cada uma e e refeito de
+	// tempos em tempos.
+	std::vector<K> fresh(queries / 5);
+	for (auto &k : fresh)
+		k = (K)(rng() | 1);
+
+	for (auto *t : {&plain, &filtered}) {
+		auto t0 = std::chrono::steady_clock::now();
+		for (auto &k : fresh)
+			t->insert(k);
+		for (auto &k : fresh)
+			t->del(k);
+		std::cout << "  insert+del " << (t == &plain ? "sem" : "com") << " filtro: "
+			<< ns_per_op(t0, 2 * fresh.size()) << " ns/op" << std::endl;
+	}
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	std::size_t queries = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5000000;
+
+	run<int>("int", n, queries);
+	run<long>("long", n, queries);
+
+	return 0;
+}
@@ -0,0 +1,80 @@
+// Vazao de uma carga mista (90% find, 10% insert/del) com varias threads:
+// BTree protegida por um unico mutex contra ConcurrentBTree.
+//
+//   $ ./bench_concurrent 1000000 2000000 8
+//       (chaves iniciais, operacoes por thread, maximo de threads)
+
+#include "../btree.hpp"
+#include "../concurrent_btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+
+class locked_btree {
+	BTree<long, 16> tree;
+	std::mutex m;
+
+public:
+	bool find(long k) { std::lock_guard l(m); return tree.find(k); }
+	bool insert(long k) { std::lock_guard l(m); return tree.insert(k); }
+	bool del(long k) { std::lock_guard l(m); return tree.del(k); }
+};
+
+template<class Tree>
+double run(Tree &tree, int threads, std::size_t ops, long range) {
+	std::vector<std::thread> workers;
+
+	auto begin = std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			std::mt19937_64 rng(t + 1);
+			for (std::size_t i = 0; i < ops; i++) {
+				long k = rng() % range;
+				unsigned op = rng() % 20;
+				if (op == 0)
+					tree.insert(k);
+				else if (op == 1)
+					tree.del(k);
+				else
+					tree.find(k);
+			}
+		});
+	}
+	for (auto &w : workers)
+		w.join();
+	auto end = std::chrono::steady_clock::now();
+
+	return threads * ops / std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	std::size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+	int max_threads = argc > 3 ? std::atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+
+	long range = 2 * (long)n;
+
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		locked_btree locked;
+		ConcurrentBTree<long, 16> olc;
+
+		std::mt19937_64 rng(0);
+		for (std::size_t i = 0; i < n; i++) {
+			long k = rng() % range;
+			locked.insert(k);
+			olc.insert(k);
+		}
+
+		double a = run(locked, threads, ops, range);
+		double b = run(olc, threads, ops, range);
+
+		std::cout << "threads=" << threads
+			<< " mutex_ops/s=" << (long long)a
+			<< " olc_ops/s=" << (long long)b << std::endl;
+	}
+
+	return 0;
+}
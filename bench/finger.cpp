@@ -0,0 +1,58 @@
+// insert com e sem enable_finger() para chaves crescentes (borda direita),
+// agrupadas (rajadas de chaves proximas em pontos diferentes da arvore) e
+// espalhadas.
+//
+//   $ ./bench_finger 10000000
+
+#include "../btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+template<class Tree>
+double insert_ns(const std::vector<long> &keys, bool finger) {
+	Tree t;
+	if (finger)
+		t.enable_finger();
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (auto k : keys)
+		t.insert(k);
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / keys.size();
+}
+
+template<class Tree>
+void run(const char *name, std::size_t n) {
+	std::mt19937_64 rng(23);
+
+	std::vector<long> sequential(n), clustered(n), uniform(n);
+	for (std::size_t i = 0; i < n; i++)
+		sequential[i] = (long)i;
+
+	// Rajadas de 1000 chaves crescentes, cada uma a partir de um ponto ao
+	// acaso.
+	for (std::size_t i = 0; i < n; i += 1000) {
+		long base = (long)(rng() >> 2);
+		for (std::size_t j = i; j < std::min(n, i + 1000); j++)
+			clustered[j] = base + (long)(j - i) * 16;
+	}
+
+	for (auto &k : uniform)
+		k = (long)(rng() >> 1);
+
+	std::cout << name << " n=" << n << std::endl;
+	for (auto [w, keys] : {std::pair{"crescente", &sequential}, {"agrupada", &clustered}, {"espalhada", &uniform}})
+		std::cout << "  " << w << ": " << insert_ns<Tree>(*keys, false) << " -> "
+			<< insert_ns<Tree>(*keys, true) << " ns/insert" << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+	run<BTree<long>>("BTree<long>", n);
+	run<BTree<long, 16>>("BTree<long, 16>", n);
+	run<BTree<long, 16, slab_pool, top_down>>("BTree<long, 16, top_down>", n);
+
+	return 0;
+}
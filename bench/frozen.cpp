@@ -0,0 +1,55 @@
+// Busca na BTree contra a mesma arvore congelada com freeze() (FrozenBTree)
+// e contra std::lower_bound num vetor ordenado, com a memoria de cada uma.
+//
+//   $ ./bench_frozen 10000000 10000000
+
+#include "../btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+template<class K>
+void run(const char *name, std::size_t n, std::size_t queries) {
+	std::mt19937_64 rng(13);
+	std::vector<K> keys(n), probes(queries);
+	for (auto &k : keys)
+		k = (K)rng();
+	for (auto &k : probes)
+		k = rng() % 2 ? keys[rng() % n] : (K)rng();
+
+	BTree<K> b;
+	b.parallel_build(keys.begin(), keys.end());
+	auto frozen = b.freeze();
+
+	std::vector<K> sorted(frozen.begin(), frozen.end());
+
+	auto time = [&](auto &&find) {
+		std::size_t found = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		for (auto &k : probes)
+			found += find(k);
+		auto t1 = std::chrono::steady_clock::now();
+		return std::make_pair(std::chrono::duration<double, std::nano>(t1 - t0).count() / queries, found);
+	};
+
+	auto [btree_ns, a] = time([&](const K &k) { return b.find(k); });
+	auto [frozen_ns, c] = time([&](const K &k) { return frozen.find(k); });
+	auto [vector_ns, d] = time([&](const K &k) { return std::binary_search(sorted.begin(), sorted.end(), k); });
+
+	std::cout << name << " n=" << n
+		<< "\n  BTree:        " << btree_ns << " ns/find, " << b.stats().bytes / (double)frozen.size() << " bytes/chave"
+		<< "\n  FrozenBTree:  " << frozen_ns << " ns/find, " << frozen.memory_usage() / (double)frozen.size() << " bytes/chave"
+		<< "\n  lower_bound:  " << vector_ns << " ns/find, " << sizeof(K) << " bytes/chave"
+		<< "\n  (found " << a << " " << c << " " << d << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	std::size_t queries = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5000000;
+
+	run<int>("int", n, queries);
+	run<long>("long", n, queries);
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+// del com a ocupacao minima padrao (o) contra set_min_fill(o / 2) e
+// set_min_fill(0), com e sem compactacao incremental: tempo medio e p99 do
+// del numa carga que alterna insert e del (o numero de chaves fica
+// parado) e numa que so apaga, e bytes por chave no fim de cada uma.
+//
+//   $ ./bench_min_fill 1000000 2000000
+
+#include "../btree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+using tree = BTree<long, 8>;
+
+struct setting {
+	const char *name;
+	std::size_t min_keys;
+	std::size_t compact_every;
+};
+
+static void report(const char *workload, const setting &s, std::vector<double> &lat, tree &t, std::size_t keys) {
+	std::sort(lat.begin(), lat.end());
+	double sum = 0;
+	for (auto l : lat)
+		sum += l;
+
+	std::cout << "  " << workload << " " << s.name << ": del " << sum / lat.size() << " ns, p99 "
+		<< lat[lat.size() * 99 / 100] << " ns, " << t.stats().bytes / (double)std::max<std::size_t>(keys, 1)
+		<< " bytes/chave" << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	std::size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+
+	setting settings[] = {
+		{"min o", 8, 0},
+		{"min o/2", 4, 0},
+		{"min 0", 0, 0},
+		{"min 0 + compact_every 16", 0, 16},
+	};
+
+	std::cout << "BTree<long, 8>, n=" << n << std::endl;
+	for (auto &s : settings) {
+		std::mt19937_64 rng(25);
+		long range = 2 * (long)n;
+
+		tree t;
+		t.set_min_fill(s.min_keys, s.compact_every);
+		std::size_t keys = 0;
+		while (keys < n)
+			keys += t.insert(rng() % range);
+
+		// insert e del alternados: cada del apaga uma chave presente.
+		std::vector<double> lat;
+		lat.reserve(ops / 2);
+		for (std::size_t i = 0; i < ops / 2; i++) {
+			long k;
+			do {
+				k = rng() % range;
+			} while (!t.insert(k));
+
+			do {
+				k = rng() % range;
+			} while (!t.find(k));
+
+			auto t0 = std::chrono::steady_clock::now();
+			t.del(k);
+			lat.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count());
+		}
+		report("alternado", s, lat, t, keys);
+
+		// So del, ate sobrar um decimo.
+		std::vector<long> present(t.begin(), t.end());
+		std::shuffle(present.begin(), present.end(), rng);
+		present.resize(present.size() * 9 / 10);
+
+		lat.clear();
+		for (auto k : present) {
+			auto t0 = std::chrono::steady_clock::now();
+			t.del(k);
+			lat.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count());
+		}
+		report("so del", s, lat, t, keys - present.size());
+	}
+
+	return 0;
+}
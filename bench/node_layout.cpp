@@ -0,0 +1,134 @@
+// Mede buscas aleatorias na BTree e conta cache misses via perf_event_open.
+//
+// O mesmo arquivo gera dois executaveis: bench_node_layout (nos com
+// arrays inline) e bench_node_layout_vector (compilado com
+// BTREE_VECTOR_NODES, nos com std::vector). Rodar os dois com os mesmos
+// parametros mostra a diferenca entre os layouts:
+//
+//   $ ./bench_node_layout 1000000 5000000
+//   $ ./bench_node_layout_vector 1000000 5000000
+
+#include "../btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+class perf_counter {
+	int fd = -1;
+
+public:
+	perf_counter(std::uint32_t type, std::uint64_t config) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+
+	~perf_counter() {
+		if (fd != -1)
+			close(fd);
+	}
+
+	bool available() const { return fd != -1; }
+
+	void start() {
+		if (fd == -1) return;
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	long long stop() {
+		if (fd == -1) return -1;
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		long long value = 0;
+		if (read(fd, &value, sizeof(value)) != sizeof(value))
+			return -1;
+		return value;
+	}
+};
+
+template<int o>
+void run(std::size_t n, std::size_t lookups) {
+	BTree<int, o> b;
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> dist(0, 4 * (int)n);
+
+	for (std::size_t i = 0; i < n; i++)
+		b.insert(dist(rng));
+
+	std::vector<int> queries(lookups);
+	for (auto &q : queries)
+		q = dist(rng);
+
+	perf_counter llc(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	perf_counter l1d(PERF_TYPE_HW_CACHE,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+	llc.start();
+	l1d.start();
+	auto begin = std::chrono::steady_clock::now();
+
+	std::size_t found = 0;
+	for (auto q : queries)
+		found += b.find(q);
+
+	auto end = std::chrono::steady_clock::now();
+	long long l1d_misses = l1d.stop();
+	long long llc_misses = llc.stop();
+
+	double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+
+	auto found_batch = std::make_unique<bool[]>(lookups);
+	begin = std::chrono::steady_clock::now();
+	b.find_batch(queries, std::span<bool>(found_batch.get(), lookups));
+	end = std::chrono::steady_clock::now();
+
+	double batch_ns = std::chrono::duration<double, std::nano>(end - begin).count();
+
+	auto per_lookup = [&](long long v) {
+		return v < 0 ? std::string("n/a") : std::to_string((double)v / lookups);
+	};
+
+	std::cout << "o=" << o
+		<< " node_bytes=" << sizeof(typename BTree<int, o>::node_type)
+		<< " ns/lookup=" << ns / lookups
+		<< " batch_ns/lookup=" << batch_ns / lookups
+		<< " l1d_miss/lookup=" << per_lookup(l1d_misses)
+		<< " llc_miss/lookup=" << per_lookup(llc_misses)
+		<< " (found " << found << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	std::size_t lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+
+#ifdef BTREE_VECTOR_NODES
+	std::cout << "layout: std::vector nodes" << std::endl;
+#else
+	std::cout << "layout: inline nodes" << std::endl;
+#endif
+	std::cout << "keys=" << n << " lookups=" << lookups << std::endl;
+
+	run<2>(n, lookups);
+	run<4>(n, lookups);
+	run<8>(n, lookups);
+	run<16>(n, lookups);
+
+	return 0;
+}
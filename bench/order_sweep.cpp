@@ -0,0 +1,64 @@
+// Varre a ordem da BTree<int>: para cada o mede insert, find e del de n
+// chaves aleatorias e mostra o tamanho do no. Serve para escolher
+// BTREE_NODE_BYTES (o tamanho de no que a BTree<T> usa por padrao) na
+// maquina de build.
+//
+//   $ ./bench_order_sweep 1000000
+
+#include "../btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <utility>
+
+template<int o>
+void run(const std::vector<int> &keys, const std::vector<int> &probes) {
+	using tree = BTree<int, o>;
+	tree b;
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (auto k : keys)
+		b.insert(k);
+	auto t1 = std::chrono::steady_clock::now();
+
+	std::size_t found = 0;
+	for (auto k : probes)
+		found += b.find(k);
+	auto t2 = std::chrono::steady_clock::now();
+
+	for (auto k : keys)
+		b.del(k);
+	auto t3 = std::chrono::steady_clock::now();
+
+	auto ns = [](auto d, std::size_t n) { return std::chrono::duration<double, std::nano>(d).count() / n; };
+
+	std::cout << "o=" << o
+		<< " node_bytes=" << sizeof(typename tree::node_type)
+		<< " insert_ns=" << ns(t1 - t0, keys.size())
+		<< " find_ns=" << ns(t2 - t1, probes.size())
+		<< " del_ns=" << ns(t3 - t2, keys.size())
+		<< (o == auto_order<int>() ? "  <- BTree<int> (BTREE_NODE_BYTES=" + std::to_string(BTREE_NODE_BYTES) + ")" : "")
+		<< " (found " << found << ")" << std::endl;
+}
+
+// Uma ordem por tamanho de no: a maior que cabe em cada numero de bytes.
+template<std::size_t... bytes>
+void sweep(std::index_sequence<bytes...>, const std::vector<int> &keys, const std::vector<int> &probes) {
+	(run<auto_order<int, bytes>()>(keys, probes), ...);
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+	std::mt19937 rng(17);
+	std::vector<int> keys(n), probes(n);
+	for (auto &k : keys)
+		k = rng();
+	for (auto &k : probes)
+		k = rng() % 2 ? keys[rng() % n] : (int)rng();
+
+	sweep(std::index_sequence<64, 128, 192, 256, 384, 512, 768, 1024, 2048, 4096>{}, keys, probes);
+
+	return 0;
+}
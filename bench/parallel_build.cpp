@@ -0,0 +1,56 @@
+// Tempo para montar uma BTree<long> com n chaves fora de ordem:
+// std::sort + bulk_load contra parallel_build com 1, 2, 4, ... threads.
+// Com a entrada ja ordenada (segunda tabela) so sobra a montagem.
+//
+//   $ ./bench_parallel_build 100000000
+
+#include "../btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void run(const char *name, const std::vector<long> &keys, unsigned max_threads) {
+	std::cout << name << std::endl;
+
+	double serial;
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		std::vector<long> sorted = keys;
+		std::sort(sorted.begin(), sorted.end());
+		BTree<long> b;
+		b.bulk_load(sorted.begin(), sorted.end());
+		serial = seconds_since(t0);
+		std::cout << "  sort + bulk_load: " << serial << " s" << std::endl;
+	}
+
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+		auto t0 = std::chrono::steady_clock::now();
+		BTree<long> b;
+		b.parallel_build(keys.begin(), keys.end(), threads);
+		double s = seconds_since(t0);
+		std::cout << "  parallel_build threads=" << threads << ": " << s << " s (" << serial / s << "x)" << std::endl;
+	}
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::mt19937_64 rng(11);
+	std::vector<long> keys(n);
+	for (auto &k : keys)
+		k = rng();
+
+	run("fora de ordem", keys, max_threads);
+
+	std::sort(keys.begin(), keys.end());
+	run("ordenada", keys, max_threads);
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+// Percentis (select) e posicao de uma chave (rank) com a BTree Ranked,
+// contra percorrer a arvore com o iterador. Mostra tambem quanto os
+// contadores custam no insert.
+//
+//   $ ./bench_rank_select 1000000 1000
+
+#include "../btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+using plain_tree = BTree<long, 16>;
+using ranked_tree = BTree<long, 16, slab_pool, bottom_up, true>;
+
+template<class Tree>
+double fill(Tree &t, const std::vector<long> &keys) {
+	auto t0 = std::chrono::steady_clock::now();
+	for (auto k : keys)
+		t.insert(k);
+	auto t1 = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(t1 - t0).count() / keys.size();
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	std::size_t queries = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000;
+
+	std::mt19937_64 rng(3);
+	std::vector<long> keys(n);
+	for (auto &k : keys)
+		k = rng() % (4 * n);
+
+	plain_tree plain;
+	ranked_tree ranked;
+	double plain_ins = fill(plain, keys);
+	double ranked_ins = fill(ranked, keys);
+
+	std::cout << "insert ns/op: plain=" << plain_ins << " ranked=" << ranked_ins << std::endl;
+
+	const double percentiles[] = {0.5, 0.9, 0.99};
+	std::size_t size = ranked.size();
+
+	// Percentis: uma caminhada ate a posicao contra select.
+	long sink = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	for (std::size_t q = 0; q < queries; q++) {
+		for (double p : percentiles) {
+			std::size_t target = (std::size_t)(p * (size - 1)), i = 0;
+			for (auto it = plain.begin(); i <= target; ++it, ++i)
+				if (i == target)
+					sink += *it;
+		}
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	for (std::size_t q = 0; q < queries; q++)
+		for (double p : percentiles)
+			sink -= ranked.select((std::size_t)(p * (size - 1)));
+	auto t2 = std::chrono::steady_clock::now();
+
+	std::cout << "percentile ns/op: walk=" << std::chrono::duration<double, std::nano>(t1 - t0).count() / (3 * queries)
+		<< " select=" << std::chrono::duration<double, std::nano>(t2 - t1).count() / (3 * queries)
+		<< " (check " << sink << ")" << std::endl;
+
+	std::vector<long> probes(queries);
+	for (auto &k : probes)
+		k = rng() % (4 * n);
+
+	std::size_t a = 0, b = 0;
+	t0 = std::chrono::steady_clock::now();
+	for (auto k : probes)
+		a += std::distance(plain.begin(), plain.lower_bound(k));
+	t1 = std::chrono::steady_clock::now();
+	for (auto k : probes)
+		b += ranked.rank(k);
+	t2 = std::chrono::steady_clock::now();
+
+	std::cout << "rank ns/op: walk=" << std::chrono::duration<double, std::nano>(t1 - t0).count() / queries
+		<< " rank=" << std::chrono::duration<double, std::nano>(t2 - t1).count() / queries
+		<< (a == b ? "" : " MISMATCH") << std::endl;
+
+	return 0;
+}
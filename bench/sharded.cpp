@@ -0,0 +1,94 @@
+// Vazao de uma carga de escrita (40% insert, 40% del, 20% find) com varias
+// threads: BTree protegida por um unico mutex contra ShardedBTree com um
+// shard por thread, com chaves uniformes e com uma faixa quente (90% das
+// operacoes em 10% das chaves), que faz os cortes se ajustarem.
+//
+//   $ ./bench_sharded 1000000 1000000 8
+//       (chaves iniciais, operacoes por thread, maximo de threads)
+
+#include "../btree.hpp"
+#include "../sharded_btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+
+class locked_btree {
+	BTree<long> tree;
+	std::mutex m;
+
+public:
+	bool find(long k) { std::lock_guard l(m); return tree.find(k); }
+	bool insert(long k) { std::lock_guard l(m); return tree.insert(k); }
+	bool del(long k) { std::lock_guard l(m); return tree.del(k); }
+};
+
+template<class Tree>
+double run(Tree &tree, int threads, std::size_t ops, long range, bool hot) {
+	std::vector<std::thread> workers;
+
+	auto begin = std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			std::mt19937_64 rng(t + 1);
+			for (std::size_t i = 0; i < ops; i++) {
+				long k = hot && rng() % 10 ? (long)(rng() % (range / 10)) : (long)(rng() % range);
+				unsigned op = rng() % 5;
+				if (op < 2)
+					tree.insert(k);
+				else if (op < 4)
+					tree.del(k);
+				else
+					tree.find(k);
+			}
+		});
+	}
+	for (auto &w : workers)
+		w.join();
+	auto end = std::chrono::steady_clock::now();
+
+	return threads * ops / std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	std::size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+	int max_threads = argc > 3 ? std::atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+
+	long range = 2 * (long)n;
+
+	for (bool hot : {false, true}) {
+		std::cout << (hot ? "faixa quente" : "uniforme") << std::endl;
+
+		for (int threads = 1; threads <= std::max(1, max_threads); threads *= 2) {
+			locked_btree locked;
+
+			// Cortes iniciais uniformes; na faixa quente o rebalanceamento
+			// automatico os move.
+			shard_options opt;
+			opt.shards = threads;
+			std::vector<long> cuts;
+			for (int i = 1; i < threads; i++)
+				cuts.push_back(range * i / threads);
+			ShardedBTree<long> sharded(opt, cuts);
+
+			std::mt19937_64 rng(0);
+			for (std::size_t i = 0; i < n; i++) {
+				long k = rng() % range;
+				locked.insert(k);
+				sharded.insert(k);
+			}
+
+			double a = run(locked, threads, ops, range, hot);
+			double b = run(sharded, threads, ops, range, hot);
+
+			std::cout << "  threads=" << threads
+				<< " mutex_ops/s=" << (long long)a
+				<< " sharded_ops/s=" << (long long)b << std::endl;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,86 @@
+// Ingestao em lotes ordenados: insert/del chave a chave contra
+// insert_sorted_batch/erase_sorted_batch, numa arvore que ja tem n chaves.
+// Em "spread" as chaves de um lote caem espalhadas pela arvore toda (quase
+// uma por folha); em "dense" cada lote cobre um trecho estreito das chaves,
+// como numa ingestao por tempo, e varias chaves caem na mesma folha.
+//
+//   $ ./bench_sorted_batch 1000000 10000 100
+//       (chaves iniciais, tamanho do lote, numero de lotes)
+
+#include "../btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+using tree = BTree<long, 16>;
+
+static double ns_per_key(std::chrono::steady_clock::duration d, std::size_t keys) {
+	return std::chrono::duration<double, std::nano>(d).count() / keys;
+}
+
+void run(const char *name, const std::vector<long> &initial, const std::vector<std::vector<long>> &lots) {
+	tree single, batched;
+	single.bulk_load(initial.begin(), initial.end());
+	batched.bulk_load(initial.begin(), initial.end());
+
+	std::size_t total = 0;
+	for (auto &lot : lots)
+		total += lot.size();
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (auto &lot : lots)
+		for (auto k : lot)
+			single.insert(k);
+	auto t1 = std::chrono::steady_clock::now();
+	for (auto &lot : lots)
+		batched.insert_sorted_batch(lot.begin(), lot.end());
+	auto t2 = std::chrono::steady_clock::now();
+
+	std::cout << name << " insert        ns/key=" << ns_per_key(t1 - t0, total) << std::endl;
+	std::cout << name << " insert_sorted ns/key=" << ns_per_key(t2 - t1, total) << std::endl;
+
+	t0 = std::chrono::steady_clock::now();
+	for (auto &lot : lots)
+		for (auto k : lot)
+			single.del(k);
+	t1 = std::chrono::steady_clock::now();
+	for (auto &lot : lots)
+		batched.erase_sorted_batch(lot.begin(), lot.end());
+	t2 = std::chrono::steady_clock::now();
+
+	std::cout << name << " del           ns/key=" << ns_per_key(t1 - t0, total) << std::endl;
+	std::cout << name << " erase_sorted  ns/key=" << ns_per_key(t2 - t1, total) << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	std::size_t batch = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000;
+	std::size_t batches = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 100;
+
+	std::mt19937_64 rng(5);
+	long range = 1000 * (long)(n + batch * batches);
+
+	std::vector<long> initial(n);
+	for (auto &k : initial)
+		k = rng() % range;
+	std::sort(initial.begin(), initial.end());
+
+	std::vector<std::vector<long>> spread(batches), dense(batches);
+	long width = range / (long)n * (long)batch / 4 + 1;
+
+	for (std::size_t b = 0; b < batches; b++) {
+		long start = rng() % (range - width);
+		for (std::size_t i = 0; i < batch; i++) {
+			spread[b].push_back(rng() % range);
+			dense[b].push_back(start + rng() % width);
+		}
+		std::sort(spread[b].begin(), spread[b].end());
+		std::sort(dense[b].begin(), dense[b].end());
+	}
+
+	run("spread", initial, spread);
+	run("dense ", initial, dense);
+
+	return 0;
+}
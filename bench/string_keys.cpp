@@ -0,0 +1,123 @@
+// Chaves std::string com prefixos longos em comum: BTree<std::string>
+// (um std::string por chave) contra StringBTree (prefixo por no e sufixos
+// num buffer). Mede tempo de insert e find e a memoria alocada por chave,
+// contando os bytes que passam pelo operator new.
+//
+//   $ ./bench_string_keys 1000000
+
+#include "../btree.hpp"
+#include "../string_btree.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+
+static std::size_t live_bytes = 0;
+
+void* operator new(std::size_t n) {
+	live_bytes += n;
+	std::size_t* p = static_cast<std::size_t*>(std::malloc(n + 16));
+	if (p == nullptr)
+		throw std::bad_alloc();
+	*p = n;
+	return reinterpret_cast<char*>(p) + 16;
+}
+
+// Todas as versoes de operator delete, com e sem tamanho, passam por
+// release e release_aligned. Fora de linha: inlinadas dentro de quem
+// chamou new, o GCC ve o cabecalho antes do bloco como fora dos limites.
+[[gnu::noinline]] static void release(void* p) {
+	if (p == nullptr)
+		return;
+	std::size_t* base = reinterpret_cast<std::size_t*>(static_cast<char*>(p) - 16);
+	live_bytes -= *base;
+	std::free(base);
+}
+
+void operator delete(void* p) noexcept {
+	release(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	release(p);
+}
+
+void* operator new(std::size_t n, std::align_val_t al) {
+	std::size_t a = std::max<std::size_t>((std::size_t)al, 16);
+	live_bytes += n;
+	char* raw = static_cast<char*>(std::aligned_alloc(a, (n + 2 * a - 1) / a * a));
+	if (raw == nullptr)
+		throw std::bad_alloc();
+	char* p = raw + a;
+	reinterpret_cast<std::size_t*>(p)[-1] = n;
+	reinterpret_cast<char**>(p)[-2] = raw;
+	return p;
+}
+
+[[gnu::noinline]] static void release_aligned(void* p) {
+	if (p == nullptr)
+		return;
+	live_bytes -= reinterpret_cast<std::size_t*>(p)[-1];
+	std::free(reinterpret_cast<char**>(p)[-2]);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+	release_aligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+	release_aligned(p);
+}
+
+template<class Tree, class Key>
+void run(const char *name, const std::vector<std::string> &keys, const std::vector<std::string> &queries) {
+	std::size_t before = live_bytes;
+	Tree t;
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (auto &k : keys)
+		t.insert(Key(k));
+	auto t1 = std::chrono::steady_clock::now();
+
+	std::size_t hits = 0;
+	for (auto &q : queries)
+		hits += t.find(Key(q));
+	auto t2 = std::chrono::steady_clock::now();
+
+	std::cout << name
+		<< " insert_ns/op=" << std::chrono::duration<double, std::nano>(t1 - t0).count() / keys.size()
+		<< " find_ns/op=" << std::chrono::duration<double, std::nano>(t2 - t1).count() / queries.size()
+		<< " bytes/key=" << (double)(live_bytes - before) / keys.size()
+		<< " (hits=" << hits << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+	std::mt19937_64 rng(11);
+	const char *regions[] = {"us-east-1", "eu-west-1", "sa-east-1", "ap-south-1"};
+
+	std::vector<std::string> keys(n);
+	for (auto &k : keys) {
+		char buf[96];
+		std::snprintf(buf, sizeof(buf), "tenants/acme-corporation/%s/orders/%012llu",
+			regions[rng() % 4], (unsigned long long)(rng() % (n * 4)));
+		k = buf;
+	}
+
+	std::vector<std::string> queries(keys);
+	std::shuffle(queries.begin(), queries.end(), rng);
+
+	std::size_t key_bytes = 0;
+	for (auto &k : keys)
+		key_bytes += k.size();
+	std::cout << "n=" << n << " avg_key_bytes=" << (double)key_bytes / n << std::endl;
+
+	run<BTree<std::string, 16>, const std::string &>("BTree<std::string,16>", keys, queries);
+	run<StringBTree<16>, std::string_view>("StringBTree<16>      ", keys, queries);
+
+	return 0;
+}
@@ -0,0 +1,334 @@
+// Bateria de benchmarks da BTree contra std::set, std::map e um
+// std::vector ordenado, com saida em CSV (uma linha por estrutura, tipo de
+// chave, distribuicao, n e carga) para comparar versoes e pegar regressoes.
+//
+//   $ ./bench_suite [max_n] [ops] [filtro] > resultado.csv
+//
+// n vai de 10^4 ate max_n (padrao 10^6; 10^8 precisa de alguns GB), ops e
+// o numero de operacoes das cargas find/range/mixed (padrao 10^6) e filtro
+// restringe as estruturas pelo nome, por exemplo "btree" ou "set/long".
+//
+// Cargas, medidas nessa ordem sobre a mesma estrutura:
+//   insert: as n chaves
+//   find:   ops buscas de chaves presentes
+//   range:  ops/10 varreduras de 100 chaves a partir de lower_bound
+//   mixed:  ops operacoes, 50% find, 25% insert, 25% del
+//   delete: as n chaves
+//
+// Distribuicoes: sequential insere 0, 1, 2, ... e consulta em ordem;
+// uniform espalha as chaves e consulta ao acaso; zipfian usa as chaves de
+// uniform mas consulta com Zipf (theta 0.99, como no YCSB), com poucas
+// chaves quentes.
+//
+// O vector ordenado so e atualizado ate n = 10^5 (cada insert/del move
+// metade do vetor); acima disso e montado com sort e so entra em find e
+// range.
+
+#include "../btree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+static std::uint64_t sink = 0;
+
+static void touch(long k) { sink += k; }
+static void touch(int k) { sink += k; }
+static void touch(const std::string &k) { sink += k.size(); }
+
+template<class K>
+K make_key(std::uint64_t x);
+
+template<>
+long make_key<long>(std::uint64_t x) { return (long)x; }
+
+template<>
+int make_key<int>(std::uint64_t x) { return (int)(std::uint32_t)x; }
+
+template<>
+std::string make_key<std::string>(std::uint64_t x) {
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "user%016llx", (unsigned long long)x);
+	return buf;
+}
+
+enum distribution { sequential, uniform, zipfian };
+static const char *distribution_names[] = {"sequential", "uniform", "zipfian"};
+
+// A i-esima chave. Multiplicar por uma constante impar e uma bijecao
+// (mod 2^32 ou 2^64), entao as chaves espalhadas continuam distintas.
+template<class K>
+K key_at(std::uint64_t i, distribution d) {
+	if (d == sequential)
+		return make_key<K>(i);
+	if constexpr (sizeof(K) == 4)
+		return make_key<K>((std::uint32_t)i * 0x9e3779b1u);
+	return make_key<K>(i * 0x9e3779b97f4a7c15ull);
+}
+
+// Gerador de Zipf de Gray et al. ("Quickly generating billion-record
+// synthetic databases"), o mesmo do YCSB. Devolve posicoes em [0, n), a 0
+// a mais frequente.
+class zipf_generator {
+	std::uint64_t n;
+	double theta, alpha, zetan, eta;
+	std::uniform_real_distribution<double> unit{0.0, 1.0};
+
+	static double zeta(std::uint64_t n, double theta) {
+		double sum = 0;
+		for (std::uint64_t i = 1; i <= n; i++)
+			sum += 1.0 / std::pow((double)i, theta);
+		return sum;
+	}
+
+public:
+	zipf_generator(std::uint64_t n, double theta = 0.99) : n(n), theta(theta) {
+		alpha = 1.0 / (1.0 - theta);
+		zetan = zeta(n, theta);
+		eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta(2, theta) / zetan);
+	}
+
+	template<class Rng>
+	std::uint64_t operator()(Rng &rng) {
+		double u = unit(rng), uz = u * zetan;
+		if (uz < 1.0)
+			return 0;
+		if (uz < 1.0 + std::pow(0.5, theta))
+			return 1;
+		return std::min<std::uint64_t>(n - 1, (std::uint64_t)(n * std::pow(eta * u - eta + 1.0, alpha)));
+	}
+};
+
+// Posicoes (em [0, n)) das chaves consultadas por cada carga.
+std::vector<std::uint64_t> positions(distribution d, std::uint64_t n, std::size_t ops, zipf_generator &zipf, std::mt19937_64 &rng) {
+	std::vector<std::uint64_t> pos(ops);
+	if (d == sequential) {
+		for (std::size_t i = 0; i < ops; i++)
+			pos[i] = i % n;
+	} else if (d == uniform) {
+		for (auto &p : pos)
+			p = rng() % n;
+	} else {
+		for (auto &p : pos)
+			p = zipf(rng);
+	}
+	return pos;
+}
+
+template<class K, int o>
+struct btree_adapter {
+	static constexpr bool cheap_updates = true;
+	BTree<K, o> t;
+
+	bool insert(const K &k) { return t.insert(k); }
+	bool find(const K &k) { return t.find(k); }
+	bool erase(const K &k) { return t.del(k); }
+
+	void scan(const K &from, std::size_t len) {
+		for (auto it = t.lower_bound(from); it != t.end() && len; ++it, --len)
+			touch(*it);
+	}
+};
+
+template<class K>
+struct set_adapter {
+	static constexpr bool cheap_updates = true;
+	std::set<K> t;
+
+	bool insert(const K &k) { return t.insert(k).second; }
+	bool find(const K &k) { return t.find(k) != t.end(); }
+	bool erase(const K &k) { return t.erase(k) == 1; }
+
+	void scan(const K &from, std::size_t len) {
+		for (auto it = t.lower_bound(from); it != t.end() && len; ++it, --len)
+			touch(*it);
+	}
+};
+
+template<class K>
+struct map_adapter {
+	static constexpr bool cheap_updates = true;
+	std::map<K, std::uint64_t> t;
+
+	bool insert(const K &k) { return t.emplace(k, 0).second; }
+	bool find(const K &k) { return t.find(k) != t.end(); }
+	bool erase(const K &k) { return t.erase(k) == 1; }
+
+	void scan(const K &from, std::size_t len) {
+		for (auto it = t.lower_bound(from); it != t.end() && len; ++it, --len)
+			touch(it->first);
+	}
+};
+
+template<class K>
+struct sorted_vector_adapter {
+	static constexpr bool cheap_updates = false;
+	std::vector<K> t;
+
+	bool insert(const K &k) {
+		auto it = std::lower_bound(t.begin(), t.end(), k);
+		if (it != t.end() && *it == k)
+			return false;
+		t.insert(it, k);
+		return true;
+	}
+
+	bool find(const K &k) { return std::binary_search(t.begin(), t.end(), k); }
+
+	bool erase(const K &k) {
+		auto it = std::lower_bound(t.begin(), t.end(), k);
+		if (it == t.end() || *it != k)
+			return false;
+		t.erase(it);
+		return true;
+	}
+
+	void scan(const K &from, std::size_t len) {
+		for (auto it = std::lower_bound(t.begin(), t.end(), from); it != t.end() && len; ++it, --len)
+			touch(*it);
+	}
+
+	void load(const std::vector<K> &keys) {
+		t = keys;
+		std::sort(t.begin(), t.end());
+	}
+};
+
+struct workload {
+	distribution dist;
+	std::vector<std::uint64_t> find, range, mixed;
+	std::vector<std::uint8_t> mixed_ops;
+};
+
+static constexpr std::size_t vector_update_limit = 100000;
+
+static void row(const std::string &structure, const char *key, int order, const workload &w, std::size_t n, const char *name, std::size_t ops, std::chrono::steady_clock::duration d) {
+	std::printf("%s,%s,", structure.c_str(), key);
+	if (order)
+		std::printf("%d", order);
+	std::printf(",%s,%zu,%s,%zu,%.2f\n", distribution_names[w.dist], n, name, ops, std::chrono::duration<double, std::nano>(d).count() / ops);
+	std::fflush(stdout);
+}
+
+template<class Adapter, class K>
+void run(const std::string &structure, const char *key, int order, const std::vector<K> &keys, const workload &w) {
+	Adapter a;
+	std::size_t n = keys.size();
+	bool updates = Adapter::cheap_updates || n <= vector_update_limit;
+	auto now = std::chrono::steady_clock::now;
+
+	auto t0 = now();
+	if (updates) {
+		for (auto &k : keys)
+			a.insert(k);
+		row(structure, key, order, w, n, "insert", n, now() - t0);
+	} else if constexpr (!Adapter::cheap_updates) {
+		a.load(keys);
+	}
+
+	t0 = now();
+	std::size_t hits = 0;
+	for (auto p : w.find)
+		hits += a.find(keys[p]);
+	row(structure, key, order, w, n, "find", w.find.size(), now() - t0);
+	sink += hits;
+
+	t0 = now();
+	for (auto p : w.range)
+		a.scan(keys[p], 100);
+	row(structure, key, order, w, n, "range", w.range.size(), now() - t0);
+
+	if (!updates)
+		return;
+
+	t0 = now();
+	for (std::size_t i = 0; i < w.mixed.size(); i++) {
+		const K &k = keys[w.mixed[i]];
+		switch (w.mixed_ops[i]) {
+		case 0:
+		case 1:
+			sink += a.find(k);
+			break;
+		case 2:
+			sink += a.insert(k);
+			break;
+		default:
+			sink += a.erase(k);
+		}
+	}
+	row(structure, key, order, w, n, "mixed", w.mixed.size(), now() - t0);
+
+	t0 = now();
+	for (auto &k : keys)
+		a.erase(k);
+	row(structure, key, order, w, n, "delete", n, now() - t0);
+}
+
+struct options {
+	std::size_t max_n = 1000000, ops = 1000000;
+	std::string filter;
+
+	bool wants(const std::string &structure, const char *key) const {
+		return (structure + "/" + key).find(filter) != std::string::npos;
+	}
+};
+
+template<class K>
+void run_key(const char *key, const options &opt) {
+	for (std::size_t n = 10000; n <= opt.max_n; n *= 10) {
+		zipf_generator zipf(n);
+		for (auto d : {sequential, uniform, zipfian}) {
+			std::vector<K> keys(n);
+			for (std::size_t i = 0; i < n; i++)
+				keys[i] = key_at<K>(i, d);
+
+			std::mt19937_64 rng(n * 3 + d);
+			workload w;
+			w.dist = d;
+			w.find = positions(d, n, opt.ops, zipf, rng);
+			w.range = positions(d, n, opt.ops / 10, zipf, rng);
+			w.mixed = positions(d, n, opt.ops, zipf, rng);
+			w.mixed_ops.resize(opt.ops);
+			for (auto &op : w.mixed_ops)
+				op = rng() % 4;
+
+			if (opt.wants("btree", key)) {
+				run<btree_adapter<K, 8>>("btree", key, 8, keys, w);
+				run<btree_adapter<K, 32>>("btree", key, 32, keys, w);
+				run<btree_adapter<K, auto_order<K>()>>("btree", key, auto_order<K>(), keys, w);
+			}
+			if (opt.wants("set", key))
+				run<set_adapter<K>>("set", key, 0, keys, w);
+			if (opt.wants("map", key))
+				run<map_adapter<K>>("map", key, 0, keys, w);
+			if (opt.wants("sorted_vector", key))
+				run<sorted_vector_adapter<K>>("sorted_vector", key, 0, keys, w);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	options opt;
+	if (argc > 1)
+		opt.max_n = std::strtoull(argv[1], nullptr, 10);
+	if (argc > 2)
+		opt.ops = std::strtoull(argv[2], nullptr, 10);
+	if (argc > 3)
+		opt.filter = argv[3];
+
+	std::printf("structure,key,order,distribution,n,workload,ops,ns_per_op\n");
+
+	run_key<int>("int", opt);
+	run_key<long>("long", opt);
+	run_key<std::string>("string", opt);
+
+	std::fprintf(stderr, "(%llu)\n", (unsigned long long)sink);
+	return 0;
+}
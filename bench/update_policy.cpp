@@ -0,0 +1,53 @@
+// Compara as politicas de atualizacao da BTree (bottom_up x top_down):
+// insere n chaves aleatorias e depois apaga todas, em outra ordem.
+//
+//   $ ./bench_update_policy 1000000
+
+#include "../btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+template<class Tree>
+void run(const char *name, const std::vector<int> &keys, const std::vector<int> &del_order) {
+	Tree b;
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (auto k : keys)
+		b.insert(k);
+	auto t1 = std::chrono::steady_clock::now();
+	for (auto k : del_order)
+		b.del(k);
+	auto t2 = std::chrono::steady_clock::now();
+
+	std::cout << name
+		<< " insert_ns/op=" << std::chrono::duration<double, std::nano>(t1 - t0).count() / keys.size()
+		<< " del_ns/op=" << std::chrono::duration<double, std::nano>(t2 - t1).count() / del_order.size()
+		<< std::endl;
+}
+
+template<int o>
+void run_order(const std::vector<int> &keys, const std::vector<int> &del_order) {
+	std::cout << "o=" << o << std::endl;
+	run<BTree<int, o, slab_pool, bottom_up>>("  bottom_up", keys, del_order);
+	run<BTree<int, o, slab_pool, top_down>>("  top_down ", keys, del_order);
+}
+
+int main(int argc, char **argv) {
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+	std::mt19937 rng(7);
+	std::vector<int> keys(n);
+	for (auto &k : keys)
+		k = rng();
+
+	std::vector<int> del_order = keys;
+	std::shuffle(del_order.begin(), del_order.end(), rng);
+
+	run_order<2>(keys, del_order);
+	run_order<8>(keys, del_order);
+	run_order<32>(keys, del_order);
+
+	return 0;
+}
@@ -0,0 +1,75 @@
+// Custo do log da DurableBTree com cada politica de fsync, e tempo para
+// reabrir (checkpoint + reaplicar o log) com checkpoints mais ou menos
+// frequentes.
+//
+//   $ ./bench_wal /tmp/bench_wal 200000
+
+#include "../durable_btree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char **argv) {
+	std::string dir = argc > 1 ? argv[1] : "/tmp/bench_wal";
+	std::size_t n = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200000;
+
+	std::mt19937_64 rng(5);
+	std::vector<long> keys(n);
+	for (auto &k : keys)
+		k = rng();
+
+	struct {
+		const char* name;
+		wal_options::sync_mode sync;
+		std::size_t ops;
+	} policies[] = {
+		{"every_op", wal_options::every_op, 0},
+		{"every_batch(64)", wal_options::every_batch, 64},
+		{"every_batch(1024)", wal_options::every_batch, 1024},
+		{"timed(10ms)", wal_options::timed, 0},
+	};
+
+	for (auto &p : policies) {
+		std::filesystem::remove_all(dir);
+		wal_options opt;
+		opt.sync = p.sync;
+		opt.batch_ops = p.ops;
+
+		// every_op faz um fsync por chave: usa menos chaves.
+		std::size_t m = p.sync == wal_options::every_op ? std::min<std::size_t>(n, 2000) : n;
+
+		DurableBTree<long> t(dir, opt);
+		auto t0 = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < m; i++)
+			t.insert(keys[i]);
+		t.commit();
+		std::cout << p.name << ": " << m / seconds_since(t0) << " insert/s" << std::endl;
+	}
+
+	// Recuperacao: o log que sobra e no maximo checkpoint_bytes.
+	for (std::size_t mb : {1, 4, 16, 64}) {
+		std::filesystem::remove_all(dir);
+		wal_options opt;
+		opt.batch_ops = 4096;
+		opt.checkpoint_bytes = mb << 20;
+		{
+			DurableBTree<long> t(dir, opt);
+			for (auto k : keys)
+				t.insert(k);
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		DurableBTree<long> t(dir, opt);
+		std::cout << "checkpoint a cada " << mb << " MiB: reabrir " << seconds_since(t0) * 1000 << " ms, log "
+		          << std::filesystem::file_size(dir + "/wal") << " bytes" << std::endl;
+	}
+
+	std::filesystem::remove_all(dir);
+}
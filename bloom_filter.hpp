@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+template<class T>
+concept bloom_hashable = requires(const T &key) {
+	{ std::hash<T>{}(key) } -> std::convertible_to<std::size_t>;
+};
+
+// Filtro de Bloom em blocos: cada chave cai num bloco de 64 bytes (uma
+// linha de cache) e liga k bits so dentro dele, entao responder "com
+// certeza nao esta" custa um cache miss. Com 10 bits por chave da uns 1%
+// de falsos positivos. Nao remove chaves; quem usa reconstroi o filtro
+// (BTree::enable_filter faz isso sozinha). T precisa ser bloom_hashable.
+template<class T>
+class bloom_filter {
+	struct alignas(64) block {
+		std::uint64_t words[8] = {};
+	};
+
+	std::vector<block> blocks;
+	std::size_t keys_capacity = 0;
+	int probes = 1;
+
+	// std::hash de inteiros costuma ser a identidade; o finalizador do
+	// splitmix64 espalha os bits.
+	static std::uint64_t hash(const T &key) {
+		std::uint64_t h = std::hash<T>{}(key);
+		h ^= h >> 30;
+		h *= 0xbf58476d1ce4e5b9ull;
+		h ^= h >> 27;
+		h *= 0x94d049bb133111ebull;
+		h ^= h >> 31;
+		return h;
+	}
+
+	// Os bits de cima escolhem o bloco; o passo entre os k bits vem de
+	// outra mistura, para nao depender do bloco.
+	static std::uint32_t second_hash(std::uint64_t h) {
+		return (std::uint32_t)((h * 0x9e3779b97f4a7c15ull) >> 32) | 1;
+	}
+
+	std::size_t block_index(std::uint64_t h) const {
+		return (std::size_t)(((h >> 32) * blocks.size()) >> 32);
+	}
+
+public:
+	// Dimensionado para capacity chaves com bits_per_key bits cada.
+	bloom_filter(std::size_t capacity, double bits_per_key = 10) : keys_capacity(std::max<std::size_t>(capacity, 1)) {
+		std::size_t bits = (std::size_t)std::ceil(keys_capacity * std::max(bits_per_key, 1.0));
+		blocks.resize(std::max<std::size_t>(1, (bits + 511) / 512));
+		probes = std::clamp((int)std::lround(bits_per_key * 0.69), 1, 16);
+	}
+
+	void add(const T &key) {
+		std::uint64_t h = hash(key);
+		block &b = blocks[block_index(h)];
+		std::uint32_t h1 = (std::uint32_t)h, h2 = second_hash(h);
+		for (int i = 0; i < probes; i++, h1 += h2)
+			b.words[(h1 >> 6) & 7] |= std::uint64_t(1) << (h1 & 63);
+	}
+
+	// false: key nunca foi adicionada. true: talvez.
+	bool may_contain(const T &key) const {
+		std::uint64_t h = hash(key);
+		const block &b = blocks[block_index(h)];
+		std::uint32_t h1 = (std::uint32_t)h, h2 = second_hash(h);
+		bool all = true;
+		for (int i = 0; i < probes; i++, h1 += h2)
+			all &= (b.words[(h1 >> 6) & 7] >> (h1 & 63)) & 1;
+		return all;
+	}
+
+	std::size_t capacity() const { return keys_capacity; }
+
+	std::size_t memory_usage() const { return blocks.size() * sizeof(block); }
+};
@@ -0,0 +1,532 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+
+#include "btree.hpp"
+
+// Arvore B+ chave/valor montada com as mesmas pecas da BTree (node_vec,
+// node_search e a politica de alocacao). Os valores ficam so nas folhas;
+// os nos internos guardam apenas chaves separadoras e ponteiros, entao
+// cabem mais filhos por linha de cache. As folhas formam uma lista
+// duplamente ligada (left_neighbor/right_neighbor) por todo o nivel, o
+// que deixa percursos e consultas por intervalo sem voltar para a raiz.
+//
+// O filho i de um no interno guarda as chaves em [keys[i-1], keys[i]).
+template <ComparableAndPrintable K, class V, int o, template<class> class Alloc = slab_pool>
+class BPlusTree {
+private:
+
+	struct node_header {
+		bool is_leaf;
+	};
+
+	struct alignas(64) Leaf : node_header {
+		node_vec<K, 2 * o + 1> keys;
+		node_vec<V, 2 * o + 1> values;
+
+		Leaf* left_neighbor = nullptr, * right_neighbor = nullptr;
+
+		Leaf() : node_header{true} {}
+
+		int find_contained(const K &key) const {
+			return node_search::count_less(keys.data(), (int)keys.size(), key);
+		}
+	};
+
+	struct alignas(64) Inner : node_header {
+		node_vec<K, 2 * o + 1> keys;
+		node_vec<node_header*, 2 * o + 2> next;
+
+		Inner() : node_header{false} {}
+
+		int find_next(const K &key) const {
+			return node_search::count_less_equal(keys.data(), (int)keys.size(), key);
+		}
+	};
+
+	Alloc<Leaf> leaf_alloc;
+	Alloc<Inner> inner_alloc;
+
+	node_header* root = nullptr;
+	std::size_t count = 0;
+
+	static Leaf* as_leaf(node_header* node) { return static_cast<Leaf*>(node); }
+	static Inner* as_inner(node_header* node) { return static_cast<Inner*>(node); }
+	static const Leaf* as_leaf(const node_header* node) { return static_cast<const Leaf*>(node); }
+	static const Inner* as_inner(const node_header* node) { return static_cast<const Inner*>(node); }
+
+	static std::size_t size_of(const node_header* node) {
+		return node->is_leaf ? as_leaf(node)->keys.size() : as_inner(node)->keys.size();
+	}
+
+	const Leaf* find_leaf(const K &key) const {
+		const node_header* node = root;
+		while (!node->is_leaf)
+			node = as_inner(node)->next[as_inner(node)->find_next(key)];
+		return as_leaf(node);
+	}
+
+	const Leaf* leftmost_leaf() const {
+		const node_header* node = root;
+		while (!node->is_leaf)
+			node = as_inner(node)->next.front();
+		return as_leaf(node);
+	}
+
+	const Leaf* rightmost_leaf() const {
+		const node_header* node = root;
+		while (!node->is_leaf)
+			node = as_inner(node)->next.back();
+		return as_leaf(node);
+	}
+
+	struct split_res {
+		bool inserted;
+		node_header* right = nullptr;
+		K sep = K();
+	};
+
+	// Folha com 2*o+1 chaves: as o de cima vao para a nova folha, e a
+	// primeira delas sobe como separador (continua na folha).
+	split_res split_leaf(Leaf* leaf) {
+		Leaf* right = leaf_alloc.create();
+
+		for (std::size_t i = o + 1; i < leaf->keys.size(); i++) {
+			right->keys.push_back(leaf->keys[i]);
+			right->values.push_back(leaf->values[i]);
+		}
+		while (leaf->keys.size() > o + 1) {
+			leaf->keys.pop_back();
+			leaf->values.pop_back();
+		}
+
+		right->left_neighbor = leaf;
+		right->right_neighbor = leaf->right_neighbor;
+		if (leaf->right_neighbor != nullptr)
+			leaf->right_neighbor->left_neighbor = right;
+		leaf->right_neighbor = right;
+
+		return {true, right, right->keys.front()};
+	}
+
+	// No interno com 2*o+1 chaves: a do meio sobe e sai do no.
+	split_res split_inner(Inner* node) {
+		Inner* right = inner_alloc.create();
+
+		for (std::size_t i = o + 1; i < node->keys.size(); i++)
+			right->keys.push_back(node->keys[i]);
+		for (std::size_t i = o + 1; i < node->next.size(); i++)
+			right->next.push_back(node->next[i]);
+
+		K sep = node->keys[o];
+		while (node->keys.size() > o)
+			node->keys.pop_back();
+		while (node->next.size() > o + 1)
+			node->next.pop_back();
+
+		return {true, right, sep};
+	}
+
+	template<bool assign>
+	split_res insert_rec(node_header* node, const K &key, const V &value) {
+		if (node->is_leaf) {
+			Leaf* leaf = as_leaf(node);
+			int pos = leaf->find_contained(key);
+
+			if (pos < (int)leaf->keys.size() && leaf->keys[pos] == key) {
+				if constexpr (assign)
+					leaf->values[pos] = value;
+				return {false};
+			}
+
+			leaf->keys.insert(leaf->keys.begin() + pos, key);
+			leaf->values.insert(leaf->values.begin() + pos, value);
+
+			if (leaf->keys.size() == 2 * o + 1)
+				return split_leaf(leaf);
+			return {true};
+		}
+
+		Inner* inner = as_inner(node);
+		int pos = inner->find_next(key);
+
+		auto res = insert_rec<assign>(inner->next[pos], key, value);
+		if (res.right == nullptr)
+			return {res.inserted};
+
+		inner->keys.insert(inner->keys.begin() + pos, res.sep);
+		inner->next.insert(inner->next.begin() + pos + 1, res.right);
+
+		if (inner->keys.size() == 2 * o + 1)
+			return split_inner(inner);
+		return {true};
+	}
+
+	// Junta o filho pos + 1 de parent no filho pos.
+	void merge_children(Inner* parent, int pos) {
+		node_header* left = parent->next[pos];
+		node_header* right = parent->next[pos + 1];
+
+		if (left->is_leaf) {
+			Leaf* l = as_leaf(left);
+			Leaf* r = as_leaf(right);
+
+			for (std::size_t i = 0; i < r->keys.size(); i++) {
+				l->keys.push_back(r->keys[i]);
+				l->values.push_back(r->values[i]);
+			}
+
+			l->right_neighbor = r->right_neighbor;
+			if (r->right_neighbor != nullptr)
+				r->right_neighbor->left_neighbor = l;
+
+			leaf_alloc.destroy(r);
+		} else {
+			Inner* l = as_inner(left);
+			Inner* r = as_inner(right);
+
+			l->keys.push_back(parent->keys[pos]);
+			for (auto &k : r->keys)
+				l->keys.push_back(k);
+			for (auto child : r->next)
+				l->next.push_back(child);
+
+			inner_alloc.destroy(r);
+		}
+
+		parent->keys.erase(parent->keys.begin() + pos);
+		parent->next.erase(parent->next.begin() + pos + 1);
+	}
+
+	// Move uma entrada do filho pos - 1 para o filho pos.
+	void borrow_from_left(Inner* parent, int pos) {
+		node_header* child = parent->next[pos];
+		node_header* left = parent->next[pos - 1];
+
+		if (child->is_leaf) {
+			Leaf* c = as_leaf(child);
+			Leaf* l = as_leaf(left);
+
+			c->keys.insert(c->keys.begin(), l->keys.back());
+			c->values.insert(c->values.begin(), l->values.back());
+			l->keys.pop_back();
+			l->values.pop_back();
+
+			parent->keys[pos - 1] = c->keys.front();
+		} else {
+			Inner* c = as_inner(child);
+			Inner* l = as_inner(left);
+
+			c->keys.insert(c->keys.begin(), parent->keys[pos - 1]);
+			c->next.insert(c->next.begin(), l->next.back());
+			parent->keys[pos - 1] = l->keys.back();
+			l->keys.pop_back();
+			l->next.pop_back();
+		}
+	}
+
+	// Move uma entrada do filho pos + 1 para o filho pos.
+	void borrow_from_right(Inner* parent, int pos) {
+		node_header* child = parent->next[pos];
+		node_header* right = parent->next[pos + 1];
+
+		if (child->is_leaf) {
+			Leaf* c = as_leaf(child);
+			Leaf* r = as_leaf(right);
+
+			c->keys.push_back(r->keys.front());
+			c->values.push_back(r->values.front());
+			r->keys.erase(r->keys.begin());
+			r->values.erase(r->values.begin());
+
+			parent->keys[pos] = r->keys.front();
+		} else {
+			Inner* c = as_inner(child);
+			Inner* r = as_inner(right);
+
+			c->keys.push_back(parent->keys[pos]);
+			c->next.push_back(r->next.front());
+			parent->keys[pos] = r->keys.front();
+			r->keys.erase(r->keys.begin());
+			r->next.erase(r->next.begin());
+		}
+	}
+
+	bool erase_rec(node_header* node, const K &key) {
+		if (node->is_leaf) {
+			Leaf* leaf = as_leaf(node);
+			int pos = leaf->find_contained(key);
+
+			if (pos == (int)leaf->keys.size() || !(leaf->keys[pos] == key))
+				return false;
+
+			leaf->keys.erase(leaf->keys.begin() + pos);
+			leaf->values.erase(leaf->values.begin() + pos);
+			return true;
+		}
+
+		Inner* inner = as_inner(node);
+		int pos = inner->find_next(key);
+
+		if (!erase_rec(inner->next[pos], key))
+			return false;
+
+		if (size_of(inner->next[pos]) >= o)
+			return true;
+
+		// Tenta pegar um elemento da esquerda, depois da direita; se nenhum
+		// dos dois pode emprestar, junta com um deles.
+		if (pos > 0 && size_of(inner->next[pos - 1]) > o)
+			borrow_from_left(inner, pos);
+		else if (pos + 1 < (int)inner->next.size() && size_of(inner->next[pos + 1]) > o)
+			borrow_from_right(inner, pos);
+		else if (pos > 0)
+			merge_children(inner, pos - 1);
+		else
+			merge_children(inner, pos);
+
+		return true;
+	}
+
+	void clear_rec(node_header* node) {
+		if (node->is_leaf) {
+			leaf_alloc.destroy(as_leaf(node));
+			return;
+		}
+		for (auto child : as_inner(node)->next)
+			clear_rec(child);
+		inner_alloc.destroy(as_inner(node));
+	}
+
+	void destroy_all() {
+		if constexpr (Alloc<Leaf>::bulk_release && std::is_trivially_destructible_v<Leaf> && std::is_trivially_destructible_v<Inner>) {
+			leaf_alloc.release_all();
+			inner_alloc.release_all();
+		} else {
+			clear_rec(root);
+			leaf_alloc.release_all();
+			inner_alloc.release_all();
+		}
+	}
+
+	void print_rec(const node_header* node, int depth = 0) const {
+		std::cout << std::string(depth * 3, ' ');
+		if (depth > 0) std::cout << "└─";
+
+		std::cout << "[";
+		if (node->is_leaf) {
+			auto leaf = as_leaf(node);
+			for (std::size_t i = 0; i < leaf->keys.size(); ++i) {
+				std::cout << leaf->keys[i];
+				if (i + 1 < leaf->keys.size()) std::cout << "|";
+			}
+		} else {
+			auto inner = as_inner(node);
+			for (std::size_t i = 0; i < inner->keys.size(); ++i) {
+				std::cout << inner->keys[i];
+				if (i + 1 < inner->keys.size()) std::cout << "|";
+			}
+		}
+		std::cout << "]" << std::endl;
+
+		if (!node->is_leaf)
+			for (auto child : as_inner(node)->next)
+				print_rec(child, depth + 1);
+	}
+
+	template<bool assign>
+	bool insert_impl(const K &key, const V &value) {
+		auto res = insert_rec<assign>(root, key, value);
+
+		if (res.right != nullptr) {
+			Inner* new_root = inner_alloc.create();
+			new_root->keys.push_back(res.sep);
+			new_root->next.push_back(root);
+			new_root->next.push_back(res.right);
+			root = new_root;
+		}
+
+		if (res.inserted)
+			count++;
+		return res.inserted;
+	}
+
+public:
+	// Iterador bidirecional sobre os pares (chave, valor) em ordem,
+	// andando pela lista de folhas. insert/erase invalidam os iteradores.
+	class const_iterator {
+		friend class BPlusTree;
+
+		const BPlusTree* tree = nullptr;
+		const Leaf* leaf = nullptr;
+		int index = 0;
+
+		const_iterator(const BPlusTree* tree, const Leaf* leaf, int index) : tree(tree), leaf(leaf), index(index) {
+			skip_exhausted();
+		}
+
+		void skip_exhausted() {
+			while (leaf != nullptr && index == (int)leaf->keys.size()) {
+				leaf = leaf->right_neighbor;
+				index = 0;
+			}
+		}
+
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = std::pair<const K&, const V&>;
+		using difference_type = std::ptrdiff_t;
+		using reference = value_type;
+
+		const_iterator() = default;
+
+		const K& key() const { return leaf->keys[index]; }
+		const V& value() const { return leaf->values[index]; }
+
+		value_type operator*() const {
+			return {key(), value()};
+		}
+
+		const_iterator& operator++() {
+			index++;
+			skip_exhausted();
+			return *this;
+		}
+
+		const_iterator operator++(int) {
+			auto copy = *this;
+			++*this;
+			return copy;
+		}
+
+		const_iterator& operator--() {
+			if (leaf == nullptr) {
+				leaf = tree->rightmost_leaf();
+				index = leaf->keys.size();
+			}
+			while (index == 0) {
+				leaf = leaf->left_neighbor;
+				index = leaf->keys.size();
+			}
+			index--;
+			return *this;
+		}
+
+		const_iterator operator--(int) {
+			auto copy = *this;
+			--*this;
+			return copy;
+		}
+
+		bool operator==(const const_iterator &other) const {
+			return leaf == other.leaf && index == other.index;
+		}
+	};
+
+	using iterator = const_iterator;
+
+	BPlusTree() {
+		root = leaf_alloc.create();
+	}
+
+	~BPlusTree() {
+		destroy_all();
+	}
+
+	BPlusTree(const BPlusTree &) = delete;
+	BPlusTree& operator=(const BPlusTree &) = delete;
+
+	std::size_t size() const {
+		return count;
+	}
+
+	// Ponteiro para o valor de key, ou nullptr se a chave nao existe.
+	const V* find(const K &key) const {
+		const Leaf* leaf = find_leaf(key);
+		int pos = leaf->find_contained(key);
+
+		if (pos < (int)leaf->keys.size() && leaf->keys[pos] == key)
+			return &leaf->values[pos];
+		return nullptr;
+	}
+
+	V* find(const K &key) {
+		return const_cast<V*>(std::as_const(*this).find(key));
+	}
+
+	bool contains(const K &key) const {
+		return find(key) != nullptr;
+	}
+
+	// Insere (key, value) se key ainda nao existe.
+	bool insert(const K &key, const V &value) {
+		return insert_impl<false>(key, value);
+	}
+
+	// Insere ou troca o valor de key. Devolve true se a chave era nova.
+	bool insert_or_assign(const K &key, const V &value) {
+		return insert_impl<true>(key, value);
+	}
+
+	bool del(const K &key) {
+		if (!erase_rec(root, key))
+			return false;
+
+		count--;
+		if (!root->is_leaf && as_inner(root)->keys.size() == 0) {
+			Inner* old_root = as_inner(root);
+			root = old_root->next.front();
+			inner_alloc.destroy(old_root);
+		}
+		return true;
+	}
+
+	void clear() {
+		destroy_all();
+		root = leaf_alloc.create();
+		count = 0;
+	}
+
+	const_iterator begin() const {
+		return const_iterator(this, leftmost_leaf(), 0);
+	}
+
+	const_iterator end() const {
+		return const_iterator(this, nullptr, 0);
+	}
+
+	// Primeiro par com chave >= key.
+	const_iterator lower_bound(const K &key) const {
+		const Leaf* leaf = find_leaf(key);
+		return const_iterator(this, leaf, leaf->find_contained(key));
+	}
+
+	// Primeiro par com chave > key.
+	const_iterator upper_bound(const K &key) const {
+		const Leaf* leaf = find_leaf(key);
+		return const_iterator(this, leaf, node_search::count_less_equal(leaf->keys.data(), (int)leaf->keys.size(), key));
+	}
+
+	// Chama fn(key, value) em ordem para cada chave em [lo, hi).
+	template<class F>
+	void for_each_in_range(const K &lo, const K &hi, F fn) const {
+		const Leaf* leaf = find_leaf(lo);
+		int i = leaf->find_contained(lo);
+
+		for (; leaf != nullptr; leaf = leaf->right_neighbor, i = 0) {
+			for (; i < (int)leaf->keys.size(); i++) {
+				if (!(leaf->keys[i] < hi))
+					return;
+				fn(leaf->keys[i], leaf->values[i]);
+			}
+		}
+	}
+
+	void print() const {
+		print_rec(root);
+	}
+};
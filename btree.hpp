@@ -0,0 +1,2494 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <iostream>
+#include <type_traits>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <cmath>
+#include <span>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+
+#include "node_search.hpp"
+#include "node_pool.hpp"
+#include "frozen_btree.hpp"
+#include "bloom_filter.hpp"
+
+template <class T>
+concept Comparable = requires(T a, T b) {
+  	{ a == b } -> std::convertible_to<bool>;
+};
+
+// Vetor de capacidade fixa guardado dentro do proprio objeto. Substitui
+// o std::vector nos nos da arvore para que chaves e filhos fiquem no
+// mesmo bloco de memoria do no, sem alocacao extra.
+template<class T, std::size_t N>
+class inline_vec {
+	std::uint32_t count = 0;
+	T items[N];
+
+public:
+	using value_type = T;
+	using iterator = T*;
+	using const_iterator = const T*;
+
+	inline_vec() = default;
+
+	inline_vec(std::initializer_list<T> l) {
+		for (auto &el : l)
+			push_back(el);
+	}
+
+	// Copiam/movem so as count posicoes usadas, nao o array inteiro.
+	inline_vec(const inline_vec &other) : count(other.count) {
+		std::copy(other.begin(), other.end(), items);
+	}
+
+	inline_vec(inline_vec &&other) : count(other.count) {
+		std::move(other.begin(), other.end(), items);
+		other.clear();
+	}
+
+	inline_vec& operator=(const inline_vec &other) {
+		if (this != &other) {
+			clear();
+			std::copy(other.begin(), other.end(), items);
+			count = other.count;
+		}
+		return *this;
+	}
+
+	inline_vec& operator=(inline_vec &&other) {
+		if (this != &other) {
+			clear();
+			std::move(other.begin(), other.end(), items);
+			count = other.count;
+			other.clear();
+		}
+		return *this;
+	}
+
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	static constexpr std::size_t capacity() { return N; }
+
+	T* data() { return items; }
+	const T* data() const { return items; }
+
+	iterator begin() { return items; }
+	iterator end() { return items + count; }
+	const_iterator begin() const { return items; }
+	const_iterator end() const { return items + count; }
+
+	T& operator[](std::size_t i) { return items[i]; }
+	const T& operator[](std::size_t i) const { return items[i]; }
+
+	T& front() { return items[0]; }
+	T& back() { return items[count - 1]; }
+	const T& front() const { return items[0]; }
+	const T& back() const { return items[count - 1]; }
+
+	void push_back(const T &val) {
+		items[count++] = val;
+	}
+
+	void push_back(T &&val) {
+		items[count++] = std::move(val);
+	}
+
+	template<class... Args>
+	T& emplace_back(Args&&... args) {
+		items[count] = T(std::forward<Args>(args)...);
+		return items[count++];
+	}
+
+	void pop_back() {
+		--count;
+		if constexpr (!std::is_trivially_destructible_v<T>)
+			items[count] = T();
+	}
+
+	iterator insert(iterator pos, const T &val) {
+		std::move_backward(pos, end(), end() + 1);
+		*pos = val;
+		count++;
+		return pos;
+	}
+
+	iterator insert(iterator pos, T &&val) {
+		std::move_backward(pos, end(), end() + 1);
+		*pos = std::move(val);
+		count++;
+		return pos;
+	}
+
+	iterator erase(iterator pos) {
+		return erase(pos, pos + 1);
+	}
+
+	iterator erase(iterator first, iterator last) {
+		auto new_end = std::move(last, end(), first);
+		while (end() != new_end)
+			pop_back();
+		return first;
+	}
+
+	void clear() {
+		while (count)
+			pop_back();
+	}
+};
+
+// Com BTREE_VECTOR_NODES os nos voltam a usar std::vector (layout antigo),
+// util para comparar os dois layouts no benchmark.
+#ifdef BTREE_VECTOR_NODES
+template<class T, std::size_t N>
+using node_vec = std::vector<T>;
+#else
+template<class T, std::size_t N>
+using node_vec = inline_vec<T, N>;
+#endif
+
+// Tamanho alvo (em bytes) dos nos da BTree quando a ordem nao e dada:
+// BTree<T> usa a maior ordem cujo no cabe nesse tamanho. O
+// bench_order_sweep mede as ordens na maquina de build; para trocar,
+// compile com -DBTREE_NODE_BYTES=... (ou cmake -DBTREE_NODE_BYTES=...).
+#ifndef BTREE_NODE_BYTES
+#define BTREE_NODE_BYTES 1024
+#endif
+
+// Mesmo layout de BTree::Node com arrays inline (sem os contadores de
+// Ranked), para calcular a ordem sem instanciar a arvore. A BTree confere
+// com static_assert que os dois continuam iguais.
+template<class T, int o>
+struct alignas(64) node_layout {
+	bool is_leaf;
+	inline_vec<T, 2 * o + 1> keys;
+	inline_vec<void*, 2 * o + 2> next;
+	void* left_neighbor, * right_neighbor;
+	std::uint64_t created;
+};
+
+// Maior o em [lo, hi] com sizeof(node_layout<T, o>) <= Bytes (busca binaria).
+template<class T, std::size_t Bytes, int lo, int hi>
+struct fit_order {
+	static constexpr int mid = (lo + hi + 1) / 2;
+	static constexpr int value = std::conditional_t<(sizeof(node_layout<T, mid>) <= Bytes),
+		fit_order<T, Bytes, mid, hi>, fit_order<T, Bytes, lo, mid - 1>>::value;
+};
+
+template<class T, std::size_t Bytes, int lo>
+struct fit_order<T, Bytes, lo, lo> {
+	static constexpr int value = lo;
+};
+
+// Ordem para nos de ate Bytes bytes: uma ou mais linhas de cache para
+// arvores em memoria, ou 4096 para um no por pagina. Nunca menos que 1.
+template<class T, std::size_t Bytes = BTREE_NODE_BYTES>
+constexpr int auto_order() {
+	return fit_order<T, Bytes, 1, (int)(Bytes / sizeof(T) / 2) + 1>::value;
+}
+
+template <class T>
+concept ComparableAndPrintable = requires(T a, T b, std::ostream &os) {
+  	{ a == b } -> std::convertible_to<bool>;            // Check for operator==
+  	{ a < b } -> std::convertible_to<bool>;             // Check for operator<
+  	{ a > b } -> std::convertible_to<bool>;             // Check for operator>
+  	{ os << a } -> std::convertible_to<std::ostream &>; // Check for printing
+};
+
+// Politicas de atualizacao da BTree (parametro Updates).
+//
+// bottom_up: o algoritmo original. insert_rec/delete_rec descem ate a
+// folha e devolvem para o pai o que precisa ser corrigido (split, troca
+// com vizinho ou merge) na volta da recursao.
+//
+// top_down: uma descida so, sem recursao. O insert divide os nos cheios
+// (2*o chaves) ja na descida, entao o pai sempre tem espaco para a chave
+// que sobe; o del garante, antes de descer para um filho, que ele tem
+// pelo menos o chaves, pegando emprestado de um vizinho ou fazendo merge.
+// Como um no cheio tem 2*o chaves, o split deixa um lado com o - 1: com
+// essa politica a ocupacao minima dos nos e o - 1 (e por isso o >= 2).
+// Nas duas o minimo do del pode ser relaxado com BTree::set_min_fill.
+struct bottom_up {};
+struct top_down {};
+
+// O que BTree::stats() devolve. Os contadores de eventos so andam quando
+// btree.hpp e compilado com BTREE_STATS (sem ele ficam em zero e nao
+// custam nada); a parte estrutural e medida percorrendo a arvore na hora.
+struct btree_stats {
+	std::uint64_t lookups = 0;        // chamadas de find()
+	std::uint64_t lookup_nodes = 0;   // nos visitados por essas buscas
+	std::uint64_t filter_rejects = 0; // buscas respondidas so pelo filtro de Bloom
+	std::uint64_t finger_inserts = 0; // inserts feitos pelo dedo (enable_finger), sem split
+	std::uint64_t splits = 0;
+	std::uint64_t merges = 0;
+	std::uint64_t borrows_left = 0;   // chave emprestada do vizinho da esquerda no del
+	std::uint64_t borrows_right = 0;
+
+	// Por nivel (levels[0] e a raiz): nos, chaves e um histograma da
+	// ocupacao dos nos em faixas de 10% de 2*o chaves.
+	struct level {
+		std::size_t nodes = 0;
+		std::size_t keys = 0;
+		std::size_t fill[10] = {};
+	};
+	std::vector<level> levels;
+
+	std::size_t height = 0;
+	std::size_t nodes = 0;
+	std::size_t bytes = 0;            // memoria dos nos, incluindo os aposentados por snapshots
+	std::size_t filter_bytes = 0;     // memoria do filtro de Bloom (enable_filter)
+
+	double nodes_per_lookup() const {
+		return lookups ? (double)lookup_nodes / lookups : 0.0;
+	}
+};
+
+#ifdef BTREE_STATS
+#define BTREE_COUNT(counter) (counters.counter++)
+#else
+#define BTREE_COUNT(counter) ((void)0)
+#endif
+
+// Sem o, a ordem vem de auto_order<T>() (nos de BTREE_NODE_BYTES bytes).
+// Alloc e a politica de alocacao dos nos (ver node_pool.hpp). Com Ranked
+// cada no guarda quantas chaves ha na subarvore de cada filho, o que
+// habilita rank() e select() em O(log n) (e size()), ao custo de
+// 8 * (2*o+2) bytes por no e de recontar os nos alterados.
+template <ComparableAndPrintable T, int o = auto_order<T>(), template<class> class Alloc = slab_pool, class Updates = bottom_up, bool Ranked = false> 
+class BTree {
+	static_assert(std::is_same_v<Updates, bottom_up> || o >= 2, "top_down precisa de o >= 2");
+
+private:
+
+  	// Cabe ate 2*o+1 chaves (uma a mais que o maximo, antes do split) e
+	// 2*o+2 filhos. Alinhado a linha de cache para a busca em um nivel
+	// tocar o menor numero possivel de linhas.
+	struct alignas(64) Node {
+		bool is_leaf = true;
+		node_vec<T, 2 * o + 1> keys;
+		node_vec<Node*, 2 * o + 2> next;
+
+		Node* left_neighbor = nullptr, * right_neighbor = nullptr;
+
+		// Versao da arvore em que o no foi criado (ver snapshot()).
+		std::uint64_t created = 0;
+
+		// Com Ranked: child[i] e o total de chaves na subarvore de next[i]
+		// e total o da subarvore do proprio no.
+		struct subtree_counts {
+			std::size_t total = 0;
+			std::size_t child[2 * o + 2];
+		};
+		struct no_counts {};
+
+		[[no_unique_address]] std::conditional_t<Ranked, subtree_counts, no_counts> counts;
+
+		inline bool needs_split() {
+			return keys.size() == o * 2 + 1;
+		}
+
+		// Insere k em ordem, com next_add (se houver) logo a direita dela.
+		template<class K>
+		void add(K &&k, Node* next_add = nullptr) {
+			int pos = find_contained(k);
+			if (next_add != nullptr)
+				next.insert(next.begin() + pos + 1, next_add);
+			keys.insert(keys.begin() + pos, std::forward<K>(k));
+		}
+
+		// As chaves acima da do meio (e os filhos a direita dela) sao movidas
+		// direto para um no novo; a do meio sai do no e e devolvida.
+		std::pair<T,Node*> split(Alloc<Node> &alloc) {
+			Node* neighbour = alloc.create();
+			neighbour->is_leaf = is_leaf;
+			neighbour->created = created;
+
+			for (std::size_t i = o + 1; i < keys.size(); i++)
+				neighbour->keys.push_back(std::move(keys[i]));
+			for (std::size_t i = o + 1; i < next.size(); i++)
+				neighbour->next.push_back(next[i]);
+
+			T middle = std::move(keys[o]);
+			keys.erase(keys.begin() + o, keys.end());
+
+			if (!neighbour->next.empty()) {
+				next.erase(next.begin() + o + 1, next.end());
+				next.back()->right_neighbor = nullptr;
+				neighbour->next.front()->left_neighbor = nullptr;
+			}
+
+			neighbour->left_neighbor = this;
+			neighbour->right_neighbor = this->right_neighbor;
+
+			if (this->right_neighbor != nullptr) {
+				this->right_neighbor->left_neighbor = neighbour;
+			}
+
+			this->right_neighbor = neighbour;
+
+			return {std::move(middle), neighbour};
+		}
+
+		int find_next(const T &key) const {
+			return node_search::count_less_equal(keys.data(), (int)keys.size(), key);
+		}
+		
+		int find_contained(const T &key) const {
+			return node_search::count_less(keys.data(), (int)keys.size(), key);
+		}
+	
+		int contains(const T &key) const {
+
+			if (keys.size() == 0) {
+
+				return false;
+			}
+
+
+			auto index = node_search::count_less(keys.data(), (int)keys.size(), key);
+			return index != keys.size() && keys[index] == key ;
+		}
+	
+	};
+
+#ifndef BTREE_VECTOR_NODES
+	static_assert(Ranked || sizeof(Node) == sizeof(node_layout<T, o>), "node_layout precisa acompanhar o layout de Node");
+#endif
+
+	Alloc<Node> alloc;
+	Node* root = nullptr;
+
+#ifdef BTREE_STATS
+	btree_stats counters;
+#endif
+
+	// Filtro de Bloom opcional (enable_filter) com todas as chaves da
+	// arvore. Como nao da para tirar chaves dele, del so conta quantas
+	// sairam; o filtro e refeito quando as adicionadas passam da capacidade
+	// ou as apagadas passam de metade delas, o que da O(1) amortizado.
+	std::unique_ptr<bloom_filter<T>> filter;
+	double filter_bits = 0;
+	std::size_t filter_added = 0;
+	std::size_t filter_removed = 0;
+
+	// Caminho do ultimo insert pelo dedo (enable_finger), da raiz ate a
+	// folha. lo e hi apontam para as chaves dos ancestrais que limitam a
+	// subarvore de node (nullptr: sem limite); continuam validos porque so
+	// a folha muda ate a proxima alteracao, que limpa o caminho.
+	struct finger_level {
+		Node* node;
+		int pos;
+		const T* lo;
+		const T* hi;
+	};
+
+	bool finger_on = false;
+	std::vector<finger_level> finger;
+
+	// Nos (fora a raiz) com menos de min_keys chaves sao rebalanceados no
+	// del (set_min_fill). compact_every e compact_cursor sao da
+	// compactacao incremental: um compact_step() a cada compact_every
+	// dels, continuando de compact_cursor.
+	std::size_t min_keys = o;
+	std::size_t compact_every = 0;
+	std::size_t dels_since_compact = 0;
+	std::optional<T> compact_cursor;
+
+	bool filtered_out(const T &key) const {
+		if constexpr (bloom_hashable<T>)
+			return filter && !filter->may_contain(key);
+		else
+			return false;
+	}
+
+	void filter_add(const T &key) {
+		if constexpr (bloom_hashable<T>)
+			if (filter)
+				filter->add(key);
+	}
+
+	// Chamado depois que added chaves entraram e removed sairam da arvore.
+	void filter_update(std::size_t added, std::size_t removed) {
+		if (!filter)
+			return;
+		filter_added += added;
+		filter_removed += removed;
+		if (filter_added > filter->capacity() || 2 * filter_removed > filter_added)
+			rebuild_filter();
+	}
+
+	void rebuild_filter() {
+		if constexpr (bloom_hashable<T>) {
+			if (!filter)
+				return;
+
+			std::size_t n = 0;
+			for (auto it = begin(); it != end(); ++it)
+				n++;
+
+			filter = std::make_unique<bloom_filter<T>>(std::max<std::size_t>(2 * n, 1024), filter_bits);
+			for (auto &key : *this)
+				filter->add(key);
+			filter_added = n;
+			filter_removed = 0;
+		}
+	}
+
+	// Snapshots por copy-on-write. snapshot() fecha a versao atual e a
+	// registra como viva; os nos com created <= shared_upto (a maior versao
+	// viva) ficam compartilhados e nao sao mais alterados. O escritor copia
+	// um no compartilhado antes de mexer nele e aposenta o original, que so
+	// e liberado quando nenhum snapshot vivo o enxerga: o snapshot da
+	// versao e ve os nos com created <= e < retired_at.
+	struct snapshot_registry {
+		std::mutex m;
+		std::multiset<std::uint64_t> live;
+		std::atomic<std::uint64_t> max_live{0};
+
+		void add(std::uint64_t e) {
+			std::lock_guard l(m);
+			live.insert(e);
+			max_live.store(*live.rbegin(), std::memory_order_release);
+		}
+
+		void remove(std::uint64_t e) {
+			std::lock_guard l(m);
+			live.erase(live.find(e));
+			max_live.store(live.empty() ? 0 : *live.rbegin(), std::memory_order_release);
+		}
+
+		std::vector<std::uint64_t> epochs() {
+			std::lock_guard l(m);
+			return std::vector<std::uint64_t>(live.begin(), live.end());
+		}
+	};
+
+	struct retired_node {
+		Node* node;
+		std::uint64_t retired_at;
+	};
+
+	std::uint64_t version = 1;
+	std::uint64_t shared_upto = 0;
+	std::shared_ptr<snapshot_registry> snapshots;
+	std::vector<retired_node> retired;
+	std::size_t reclaim_at = 256;
+
+	template<class... Args>
+	Node* new_node(Args&&... args) {
+		Node* node = alloc.create(std::forward<Args>(args)...);
+		node->created = version;
+		return node;
+	}
+
+	bool is_shared(const Node* node) const {
+		return node->created <= shared_upto;
+	}
+
+	// Libera o no, ou aposenta se algum snapshot ainda pode ve-lo.
+	void drop(Node* node) {
+		if (is_shared(node))
+			retired.push_back({node, version});
+		else
+			alloc.destroy(node);
+	}
+
+	Node* clone(Node* node) {
+		Node* copy = new_node(*node);
+		retired.push_back({node, version});
+		return copy;
+	}
+
+	// Toda alteracao da arvore, fora o insert pelo dedo, passa por aqui ou
+	// por release_tree, entao e aqui que o dedo deixa de valer.
+	void own_root() {
+		finger.clear();
+		if (shared_upto != 0 && is_shared(root))
+			root = clone(root);
+	}
+
+	// Garante que os filhos de node (que ja e do escritor) podem ser
+	// alterados. Como os vizinhos ligam irmaos do mesmo pai, os irmaos sao
+	// copiados juntos e religados entre si: um no compartilhado nunca tem
+	// os ponteiros de vizinho alterados.
+	void own_children(Node* node) {
+		if (shared_upto == 0 || node->is_leaf)
+			return;
+
+		bool changed = false;
+		for (auto &child : node->next) {
+			if (is_shared(child)) {
+				child = clone(child);
+				changed = true;
+			}
+		}
+
+		if (changed)
+			link_children(node);
+	}
+
+	void refresh_shared() {
+		shared_upto = snapshots ? snapshots->max_live.load(std::memory_order_acquire) : 0;
+	}
+
+	// Libera os nos aposentados que nenhum snapshot vivo enxerga mais.
+	void reclaim() {
+		std::vector<std::uint64_t> live;
+		if (shared_upto != 0)
+			live = snapshots->epochs();
+
+		std::size_t kept = 0;
+		for (auto r : retired) {
+			auto it = std::lower_bound(live.begin(), live.end(), r.node->created);
+			if (it != live.end() && *it < r.retired_at)
+				retired[kept++] = r;
+			else
+				alloc.destroy(r.node);
+		}
+		retired.resize(kept);
+
+		reclaim_at = std::max<std::size_t>(256, 2 * kept);
+	}
+
+	void maybe_reclaim() {
+		if (!retired.empty() && (shared_upto == 0 || retired.size() >= reclaim_at))
+			reclaim();
+	}
+
+	// Recalcula os contadores de node a partir dos filhos, que ja precisam
+	// estar certos (por isso os nos alterados sao recontados de baixo para
+	// cima).
+	static void recount(Node* node) {
+		if constexpr (Ranked) {
+			std::size_t total = node->keys.size();
+			for (std::size_t i = 0; i < node->next.size(); i++) {
+				node->counts.child[i] = node->next[i]->counts.total;
+				total += node->counts.child[i];
+			}
+			node->counts.total = total;
+		}
+	}
+
+	// Reconta o filho pos de node e os irmaos ao lado dele.
+	static void recount_around(Node* node, int pos) {
+		if constexpr (Ranked) {
+			int last = (int)node->next.size() - 1;
+			for (int i = std::max(pos - 1, 0); i <= std::min(pos + 1, last); i++)
+				recount(node->next[i]);
+		}
+	}
+
+	struct insert_rec_res {
+		bool inserted;
+		bool need_append_parent;
+		T key;
+		Node* next;
+	};
+
+	std::pair<T, Node*> split_node(Node* node) {
+		BTREE_COUNT(splits);
+		return node->split(alloc);
+	}
+
+	template<class K>
+	insert_rec_res insert_rec(Node* node, K &&key) {
+
+		if (node->contains(key)) {
+			return {false, false};
+		}
+
+
+		if(node->is_leaf){
+
+			node->add(std::forward<K>(key));
+
+
+			if (node->needs_split()) {
+
+				auto [middle, neighbour] = split_node(node);
+
+				recount(node);
+				recount(neighbour);
+				return {true, true, std::move(middle), neighbour};
+			}
+			recount(node);
+			return {true, false};
+		}
+
+		int next_index = node->find_next(key);
+
+		own_children(node);
+		auto [inserted, need_append, to_append, to_append_next] = insert_rec(node->next[next_index], std::forward<K>(key));
+
+		if(!inserted)
+			return {false, false};
+
+		if (need_append) {
+
+			node->add(std::move(to_append), to_append_next);
+
+			if (node->needs_split()) {
+				auto [middle, neighbour] = split_node(node);
+				recount(node);
+				recount(neighbour);
+				return {true, true, std::move(middle), neighbour};
+			}
+		}
+
+		recount(node);
+		return {true, false};
+	}
+
+
+	void print_rec(Node* node, int depth = 0) {
+
+		std::cout << std::string(depth * 3, ' ');
+		if (depth > 0) std::cout << "└─";
+
+		std::cout << "[";
+		for (size_t i = 0; i < node->keys.size(); ++i) {
+			std::cout << node->keys[i];
+			if (i + 1 < node->keys.size()) std::cout << "|";
+		}
+		std::cout << "]" << std::endl;
+
+
+		for (auto child : node->next)
+			print_rec(child, depth + 1);
+
+	}
+
+
+	enum direction{
+		left, none, right
+	};
+
+	struct delete_rec_res {
+		bool deleted;
+		direction swap = direction::none;
+		T swap_parent_for;
+
+		direction merge = direction::none;
+	};
+
+	// get_max_ptr
+
+	void merge(Node*node, int pos) {
+		BTREE_COUNT(merges);
+
+		auto child = node->next[pos];
+		auto right = child->right_neighbor;
+
+		own_children(child);
+		own_children(right);
+
+		// As chaves sao movidas: right e do escritor (own_children do pai) e
+		// e solta no fim.
+		child->keys.push_back(std::move(node->keys[pos]));
+		node->keys.erase(node->keys.begin() + pos);
+
+		for(auto &el : right->keys) {
+			child->keys.push_back(std::move(el));
+		}
+
+		// Se um tiver next o outro obrigatoriamente tem tambem.
+		if(child->next.size() && right->next.size()) {
+			child->next[child->next.size()-1]->right_neighbor = right->next[0];
+			right->next[0]->left_neighbor = child->next[child->next.size()-1];
+		}
+
+
+		for(auto el : right->next) {
+			child->next.push_back(el);
+		}
+
+		child->right_neighbor = right->right_neighbor;
+		if (child->right_neighbor != nullptr)
+			child->right_neighbor->left_neighbor = child;
+
+
+		node->next.erase(node->next.begin() + pos + 1);
+
+		drop(right);
+	}
+
+	Node* get_max_node_of(Node* node) {
+		if (node->is_leaf) {
+			return node;				
+		}
+
+		return get_max_node_of(node->next.back());
+	}
+
+	delete_rec_res delete_rec(Node* node, T key, bool p=false) {
+
+		if (p) {
+
+			for(int i = 0; i < node->keys.size(); i++)
+				std:: cout <<node->keys[i] << "|";
+			std::cout << " --> ";
+
+			std::cout << key << std::endl;
+		}
+
+		int next_node = -1;
+
+		own_children(node);
+
+		if (node->contains(key)) {
+			if(node->is_leaf) {
+
+				node->keys.erase(node->keys.begin() + node->find_contained(key));
+				// Caso trivial
+				if(node->keys.size() >= min_keys) {
+					return {true};
+				}
+
+				// Tenta pegar um elemento da esquerda
+				if(node->left_neighbor != nullptr && node->left_neighbor->keys.size() > min_keys) {
+					T to_swap = std::move(node->left_neighbor->keys.back());
+					node->left_neighbor->keys.pop_back();
+
+					BTREE_COUNT(borrows_left);
+					return {true, left, std::move(to_swap)};
+				}
+
+				// Tenta pegar um elemento da direita
+				if(node->right_neighbor != nullptr && node->right_neighbor->keys.size() > min_keys) {
+					T to_swap = std::move(node->right_neighbor->keys.front());
+					node->right_neighbor->keys.erase(node->right_neighbor->keys.begin());
+
+					BTREE_COUNT(borrows_right);
+					return {true, right, std::move(to_swap)};
+				}
+
+				// Requisita merge para desta pagina com a da esquerda
+				if(node->left_neighbor != nullptr) {
+
+					return {true, none, key, left};
+				}
+
+				// Requisita merge para desta pagina com a da direita
+				if(node->right_neighbor != nullptr) {
+
+					return {true, none, key, right};
+				}
+
+				return {true};
+			}
+				
+			int pos = node->find_contained(key);	
+
+			auto end_node = get_max_node_of(node->next[pos]);
+
+			node->keys[pos] = end_node->keys.back();
+
+			key = end_node->keys.back();
+			next_node = pos;
+		} 
+
+		if (node->is_leaf)
+			return {false};
+		
+		if (next_node  == -1)
+			next_node = node->find_next(key);
+
+
+		auto [deleted, needs_parent_swap, swap_for, merge_type] = delete_rec( node->next[next_node], key, p);
+
+		if(p)
+		std::cout << deleted << " " << needs_parent_swap << " " << swap_for << " " << merge_type << std::endl;
+
+		if (!deleted) return {false};
+
+
+		if (needs_parent_swap != none) {
+			int key_node= next_node;
+			if (needs_parent_swap == left) key_node--;
+
+			// A chave do pai desce para o filho: vira a menor chave se veio
+			// da esquerda e a maior se veio da direita.
+			auto child = node->next[next_node];
+			if (needs_parent_swap == left)
+				child->keys.insert(child->keys.begin(), std::move(node->keys[key_node]));
+			else
+				child->keys.push_back(std::move(node->keys[key_node]));
+			node->keys[key_node] = std::move(swap_for);
+
+			recount_around(node, next_node);
+			return {true, direction::none, key, direction::none};
+		}
+
+		if (merge_type != none) {
+
+			int key_node= next_node;
+			if (merge_type == left) key_node--;
+
+			merge(node, key_node);
+			recount_around(node, key_node);
+
+			if (node->keys.size() < min_keys) {
+
+
+				// Tenta pegar um elemento da esquerda
+				if(node->left_neighbor != nullptr && node->left_neighbor->keys.size() > min_keys) {
+					own_children(node->left_neighbor);
+
+					T to_swap = std::move(node->left_neighbor->keys.back());
+					node->left_neighbor->keys.pop_back();
+
+
+
+					auto next_swap = node->left_neighbor->next.back();
+					node->left_neighbor->next.pop_back();
+
+					next_swap->left_neighbor->right_neighbor = nullptr;
+					next_swap->left_neighbor = nullptr;
+
+					next_swap->right_neighbor = node->next.front();
+	
+					node->next[0]->left_neighbor = next_swap;
+
+					node->next.insert(node->next.begin(), next_swap);
+
+					BTREE_COUNT(borrows_left);
+					return {true, left, std::move(to_swap)};
+				}
+
+				// Tenta pegar um elemento da direita
+				if(node->right_neighbor != nullptr && node->right_neighbor->keys.size() > min_keys) {
+					own_children(node->right_neighbor);
+
+					T to_swap = std::move(node->right_neighbor->keys.front());
+					node->right_neighbor->keys.erase(node->right_neighbor->keys.begin());
+
+
+					auto next_swap = node->right_neighbor->next.front();
+					node->right_neighbor->next.erase(node->right_neighbor->next.begin());
+
+					next_swap->right_neighbor->left_neighbor = nullptr;
+					next_swap->right_neighbor = nullptr;
+
+					next_swap->left_neighbor = node->next.back();
+					node->next.back()->right_neighbor = next_swap;
+
+					node->next.push_back(next_swap);
+
+					BTREE_COUNT(borrows_right);
+					return {true, right, std::move(to_swap)};
+				}
+
+
+
+				if(node->left_neighbor != nullptr) {
+					return {true, direction::none, key, left};
+				}
+
+				if(node->right_neighbor != nullptr) {
+					return {true, direction::none, key, right};
+				}
+			}
+		}
+
+		recount_around(node, next_node);
+		return {true};
+	}
+
+	// Divide o filho pos de node (cheio, 2*o chaves) na descida do
+	// top_down. A chave do meio sobe para node na posicao pos.
+	void split_child(Node* node, int pos) {
+		own_children(node->next[pos]);
+		auto [key, neighbour] = split_node(node->next[pos]);
+		node->keys.insert(node->keys.begin() + pos, std::move(key));
+		node->next.insert(node->next.begin() + pos + 1, neighbour);
+		recount(node->next[pos]);
+		recount(neighbour);
+	}
+
+	// Passa a ultima chave do filho pos - 1 para o pai e a chave do pai
+	// para o comeco do filho pos (com o ultimo neto, se houver).
+	void rotate_from_left(Node* node, int pos) {
+		BTREE_COUNT(borrows_left);
+		Node* child = node->next[pos];
+		Node* left_node = node->next[pos - 1];
+
+		own_children(child);
+		own_children(left_node);
+
+		child->keys.insert(child->keys.begin(), node->keys[pos - 1]);
+		node->keys[pos - 1] = left_node->keys.back();
+		left_node->keys.pop_back();
+
+		if (!child->is_leaf) {
+			Node* moved = left_node->next.back();
+			left_node->next.pop_back();
+
+			moved->left_neighbor->right_neighbor = nullptr;
+			moved->left_neighbor = nullptr;
+			moved->right_neighbor = child->next.front();
+			child->next.front()->left_neighbor = moved;
+
+			child->next.insert(child->next.begin(), moved);
+		}
+
+		recount(child);
+		recount(left_node);
+	}
+
+	// Simetrico de rotate_from_left, pegando do filho pos + 1.
+	void rotate_from_right(Node* node, int pos) {
+		BTREE_COUNT(borrows_right);
+		Node* child = node->next[pos];
+		Node* right_node = node->next[pos + 1];
+
+		own_children(child);
+		own_children(right_node);
+
+		child->keys.push_back(node->keys[pos]);
+		node->keys[pos] = right_node->keys.front();
+		right_node->keys.erase(right_node->keys.begin());
+
+		if (!child->is_leaf) {
+			Node* moved = right_node->next.front();
+			right_node->next.erase(right_node->next.begin());
+
+			moved->right_neighbor->left_neighbor = nullptr;
+			moved->right_neighbor = nullptr;
+			moved->left_neighbor = child->next.back();
+			child->next.back()->right_neighbor = moved;
+
+			child->next.push_back(moved);
+		}
+
+		recount(child);
+		recount(right_node);
+	}
+
+	// Se um merge deixou a raiz sem chaves, o unico filho vira a raiz.
+	void shrink_root() {
+		if (root->keys.size() == 0 && root->next.size() == 1) {
+			auto old_root = root;
+			root = root->next.back();
+			drop(old_root);
+		}
+	}
+
+	// Nos por onde a descida do top_down passou, para no fim recontar de
+	// baixo para cima (so com Ranked). Com pelo menos 2 filhos por no a
+	// altura nunca passa de 64.
+	struct descent_path {
+		Node* nodes[64];
+		int depth = 0;
+
+		void push(Node* node) {
+			if constexpr (Ranked)
+				nodes[depth++] = node;
+		}
+
+		void recount_all() {
+			if constexpr (Ranked)
+				while (depth)
+					recount(nodes[--depth]);
+		}
+	};
+
+	// insert(const T&) e insert(T&&): a chave so e copiada (ou movida) uma
+	// vez, para o no onde fica.
+	template<class K>
+	bool insert_one(K &&key) {
+		// Antes de key ser movida; se ja estava na arvore nao faz mal.
+		filter_add(key);
+
+		refresh_shared();
+
+		// key so e movida se o dedo inserir.
+		if (finger_on && shared_upto == 0) {
+			int res = finger_insert(std::forward<K>(key));
+			if (res == 1)
+				filter_update(1, 0);
+			if (res != -1)
+				return res == 1;
+		}
+
+		// Com snapshots vivos nao copia o caminho a toa.
+		if (shared_upto != 0 && find_rec(root, key))
+			return false;
+
+		own_root();
+
+		bool inserted;
+		if constexpr (std::is_same_v<Updates, top_down>) {
+			inserted = insert_top_down(std::forward<K>(key));
+		} else {
+			auto [ins, need_append, to_append, to_append_next] = insert_rec(root, std::forward<K>(key));
+
+			if(need_append) {
+				Node* node = new_node();
+				node->is_leaf = false;
+				node->keys.push_back(std::move(to_append));
+				node->next.push_back(root);
+				node->next.push_back(to_append_next);
+				root = node;
+				recount(root);
+			}
+			inserted = ins;
+		}
+
+		maybe_reclaim();
+		if (inserted)
+			filter_update(1, 0);
+		return inserted;
+	}
+
+	// Sobe pelo caminho guardado ate o primeiro no cuja subarvore cobre
+	// key e desce dali ate a folha, refazendo o caminho. Devolve 1 se
+	// inseriu na folha, 0 se key ja estava na arvore e -1 se a folha esta
+	// cheia: o insert normal faz o split (e limpa o caminho, que e refeito
+	// da raiz no proximo insert).
+	template<class K>
+	int finger_insert(K &&key) {
+		while (!finger.empty()) {
+			auto &f = finger.back();
+			if ((f.lo != nullptr && *f.lo == key) || (f.hi != nullptr && *f.hi == key))
+				return 0;
+			if ((f.lo == nullptr || *f.lo < key) && (f.hi == nullptr || key < *f.hi))
+				break;
+			finger.pop_back();
+		}
+		if (finger.empty())
+			finger.push_back({root, 0, nullptr, nullptr});
+
+		Node* node = finger.back().node;
+		int pos;
+		while (true) {
+			pos = node->find_contained(key);
+			if (pos < (int)node->keys.size() && node->keys[pos] == key)
+				return 0;
+			if (node->is_leaf)
+				break;
+
+			auto &f = finger.back();
+			f.pos = pos;
+			const T* lo = pos > 0 ? &node->keys[pos - 1] : f.lo;
+			const T* hi = pos < (int)node->keys.size() ? &node->keys[pos] : f.hi;
+			node = node->next[pos];
+			finger.push_back({node, 0, lo, hi});
+		}
+
+		// Com 2*o - 1 chaves ou menos a folha nao divide em nenhuma das
+		// politicas.
+		if (node->keys.size() >= 2 * o)
+			return -1;
+
+		node->keys.insert(node->keys.begin() + pos, std::forward<K>(key));
+		if constexpr (Ranked) {
+			for (auto &f : finger) {
+				f.node->counts.total++;
+				if (!f.node->is_leaf)
+					f.node->counts.child[f.pos]++;
+			}
+		}
+
+		BTREE_COUNT(finger_inserts);
+		return 1;
+	}
+
+	template<class K>
+	bool insert_top_down(K &&key) {
+		if (root->keys.size() == 2 * o) {
+			Node* node = new_node();
+			node->is_leaf = false;
+			node->next.push_back(root);
+			root = node;
+			split_child(root, 0);
+		}
+
+		descent_path path;
+		Node* node = root;
+		while (true) {
+			path.push(node);
+
+			int pos = node->find_contained(key);
+			if (pos < (int)node->keys.size() && node->keys[pos] == key) {
+				path.recount_all();
+				return false;
+			}
+
+			if (node->is_leaf) {
+				node->keys.insert(node->keys.begin() + pos, std::forward<K>(key));
+				path.recount_all();
+				return true;
+			}
+
+			own_children(node);
+
+			if (node->next[pos]->keys.size() == 2 * o) {
+				split_child(node, pos);
+
+				if (node->keys[pos] == key) {
+					path.recount_all();
+					return false;
+				}
+				if (node->keys[pos] < key)
+					pos++;
+			}
+
+			node = node->next[pos];
+		}
+	}
+
+	bool delete_top_down(T key) {
+		descent_path path;
+		Node* node = root;
+
+		while (true) {
+			// Um merge na raiz pode ter trocado a raiz (e liberado a antiga).
+			if (node == root)
+				path.depth = 0;
+			path.push(node);
+
+			int pos = node->find_contained(key);
+			bool found = pos < (int)node->keys.size() && node->keys[pos] == key;
+
+			if (node->is_leaf) {
+				if (found)
+					node->keys.erase(node->keys.begin() + pos);
+				path.recount_all();
+				return found;
+			}
+
+			own_children(node);
+
+			if (found) {
+				Node* left_node = node->next[pos];
+				Node* right_node = node->next[pos + 1];
+
+				// Troca pelo antecessor (ou sucessor) e continua apagando
+				// ele na subarvore correspondente.
+				if (left_node->keys.size() >= min_keys) {
+					Node* n = left_node;
+					while (!n->is_leaf)
+						n = n->next.back();
+
+					node->keys[pos] = n->keys.back();
+					key = n->keys.back();
+					node = left_node;
+					continue;
+				}
+
+				if (right_node->keys.size() >= min_keys) {
+					Node* n = right_node;
+					while (!n->is_leaf)
+						n = n->next.front();
+
+					node->keys[pos] = n->keys.front();
+					key = n->keys.front();
+					node = right_node;
+					continue;
+				}
+
+				// Os dois tem min_keys - 1 chaves: junta tudo (com key) no da
+				// esquerda.
+				merge(node, pos);
+				shrink_root();
+				node = left_node;
+				continue;
+			}
+
+			Node* child = node->next[pos];
+
+			if (child->keys.size() < min_keys) {
+				if (pos > 0 && node->next[pos - 1]->keys.size() >= min_keys) {
+					rotate_from_left(node, pos);
+				} else if (pos < (int)node->keys.size() && node->next[pos + 1]->keys.size() >= min_keys) {
+					rotate_from_right(node, pos);
+				} else if (pos < (int)node->keys.size()) {
+					merge(node, pos);
+				} else {
+					child = node->next[pos - 1];
+					merge(node, pos - 1);
+				}
+				shrink_root();
+			}
+
+			node = child;
+		}
+	}
+
+	void clear_rec(Node* node) {
+		if (node->is_leaf) {
+			alloc.destroy(node);
+			return;
+		}
+		for(auto a : node->next) {
+			clear_rec(a);
+		}
+		alloc.destroy(node);
+	}
+
+	// Com o pool, se os nos nao precisam de destrutor basta devolver os
+	// slabs; so visita a arvore quando ha destrutores para chamar.
+	void destroy_all() {
+		for (auto r : retired)
+			alloc.destroy(r.node);
+		retired.clear();
+
+		if constexpr (Alloc<Node>::bulk_release) {
+			if constexpr (!std::is_trivially_destructible_v<Node>)
+				clear_rec(root);
+			alloc.release_all();
+		} else {
+			clear_rec(root);
+		}
+	}
+
+	// Solta a arvore atual sem destruir o que os snapshots vivos usam.
+	void release_rec(Node* node) {
+		for (auto child : node->next)
+			release_rec(child);
+		drop(node);
+	}
+
+	void release_tree() {
+		finger.clear();
+		refresh_shared();
+		if (shared_upto != 0)
+			release_rec(root);
+		else
+			destroy_all();
+	}
+
+	static std::size_t node_bytes([[maybe_unused]] const Node* node) {
+#ifdef BTREE_VECTOR_NODES
+		return sizeof(Node) + node->keys.capacity() * sizeof(T) + node->next.capacity() * sizeof(Node*);
+#else
+		return sizeof(Node);
+#endif
+	}
+
+	// Traz as linhas de cache do no para perto antes de ele ser lido.
+	static void prefetch_node(const Node* node) {
+		for (std::size_t off = 0; off < sizeof(Node); off += 64)
+			__builtin_prefetch(reinterpret_cast<const char*>(node) + off);
+	}
+
+	static bool find_rec(const Node* node, const T &key) {
+		if( node->contains(key) )
+			return true;
+		if(node->is_leaf)
+			return false;
+
+		return find_rec(node->next[node->find_next(key)], key);
+	}
+
+	// Visita em ordem as chaves de node em [lo, hi). Devolve false quando
+	// passou de hi, para os niveis de cima pararem tambem.
+	template<class F>
+	static bool range_rec(const Node* node, const T &lo, const T &hi, F &fn) {
+		int i = node->find_contained(lo);
+
+		for (; i <= (int)node->keys.size(); i++) {
+			if (!node->is_leaf && !range_rec(node->next[i], lo, hi, fn))
+				return false;
+
+			if (i == (int)node->keys.size())
+				break;
+			if (!(node->keys[i] < hi))
+				return false;
+
+			fn(node->keys[i]);
+		}
+
+		return true;
+	}
+
+	// Em quantos nos dividir n chaves (g nos separados por g-1 chaves) para
+	// cada no ficar perto de per chaves, sem sair de [o, 2*o]. Com poucas
+	// chaves sobra um no so, que pode ficar abaixo de o (vira a raiz).
+	static std::size_t group_count(std::size_t n, std::size_t per) {
+		std::size_t g = (n + 1 + per) / (per + 1);
+		std::size_t lo = (n + 1 + 2 * o) / (2 * o + 1);
+		std::size_t hi = std::max(lo, (n + 1) / (o + 1));
+		return std::clamp(g, lo, hi);
+	}
+
+	// Liga os filhos de node entre si; os das pontas ficam sem vizinho
+	// (os vizinhos sao sempre irmaos do mesmo pai).
+	static void link_children(Node* node) {
+		for (std::size_t i = 0; i < node->next.size(); i++) {
+			node->next[i]->left_neighbor = i > 0 ? node->next[i - 1] : nullptr;
+			node->next[i]->right_neighbor = i + 1 < node->next.size() ? node->next[i + 1] : nullptr;
+		}
+	}
+
+	// Monta um nivel acima de children. seps[i] separa children[i] de
+	// children[i+1]; sem filhos (children vazio) monta o nivel das folhas
+	// direto de seps. Devolve os separadores do novo nivel em seps.
+	std::vector<Node*> build_level(const std::vector<Node*> &children, std::vector<T> &seps, std::size_t per) {
+		std::size_t g = group_count(seps.size(), per);
+		std::vector<Node*> level(g);
+		std::vector<T> up(g - 1);
+
+		build_groups(children, seps, g, 0, g, level, up, alloc);
+
+		seps = std::move(up);
+		return level;
+	}
+
+	// Monta os nos [i0, i1) dos g de um nivel (ver build_level), alocando
+	// em a. O no i comeca na chave (e no filho) i * (base + 1) + min(i, extra),
+	// entao cada trecho pode ser montado sem olhar os outros.
+	void build_groups(const std::vector<Node*> &children, const std::vector<T> &seps, std::size_t g,
+			std::size_t i0, std::size_t i1, std::vector<Node*> &level, std::vector<T> &up, Alloc<Node> &a) {
+		std::size_t n = seps.size();
+		std::size_t base = (n - (g - 1)) / g, extra = (n - (g - 1)) % g;
+
+		for (std::size_t i = i0; i < i1; i++) {
+			std::size_t k = i * (base + 1) + std::min(i, extra);
+			std::size_t cnt = base + (i < extra);
+
+			Node* node = a.create();
+			node->created = version;
+
+			for (std::size_t j = 0; j < cnt; j++)
+				node->keys.push_back(seps[k + j]);
+
+			if (!children.empty()) {
+				node->is_leaf = false;
+				for (std::size_t j = 0; j <= cnt; j++)
+					node->next.push_back(children[k + j]);
+				link_children(node);
+			}
+			recount(node);
+
+			if (i + 1 < g)
+				up[i] = seps[k + cnt];
+
+			level[i] = node;
+		}
+	}
+
+	// Roda fn(0), ..., fn(parts - 1), cada um numa thread (fn(0) na atual).
+	template<class F>
+	static void parallel_for(unsigned parts, F fn) {
+		std::vector<std::thread> pool;
+		for (unsigned t = 1; t < parts; t++)
+			pool.emplace_back(fn, t);
+		fn(0u);
+		for (auto &th : pool)
+			th.join();
+	}
+
+	// Copia [first, first + n) e devolve ordenado e sem repetidos, com
+	// threads threads. Entrada ja ordenada so e copiada; senao e um sample
+	// sort: uma amostra escolhe threads - 1 divisores, cada thread espalha o
+	// seu pedaco pelos baldes e depois cada balde e ordenado por uma thread.
+	template<std::random_access_iterator It>
+	static std::vector<T> parallel_sort_unique(It first, std::size_t n, unsigned threads) {
+		auto cut = [&](std::size_t i) { return n * i / threads; };
+
+		std::vector<T> src(n);
+		std::vector<char> chunk_sorted(threads);
+		parallel_for(threads, [&](unsigned t) {
+			std::copy(first + cut(t), first + cut(t + 1), src.begin() + cut(t));
+			chunk_sorted[t] = std::is_sorted(src.begin() + cut(t), src.begin() + cut(t + 1));
+		});
+
+		bool sorted = std::all_of(chunk_sorted.begin(), chunk_sorted.end(), [](char c) { return c; });
+		for (unsigned t = 1; t < threads && sorted; t++)
+			if (cut(t) != 0 && cut(t) < n && src[cut(t)] < src[cut(t) - 1])
+				sorted = false;
+
+		// Trechos [lo[b], hi[b]) de buf, cada um ordenado e sem repetidos, com
+		// as chaves do trecho b todas menores que as do b + 1.
+		std::vector<T> tmp;
+		std::vector<T>* buf = &src;
+		std::vector<std::size_t> lo(threads), hi(threads);
+
+		if (sorted) {
+			// Repetidos podem cruzar a fronteira entre pedacos: cada pedaco
+			// pula os que sao iguais a ultima chave do anterior.
+			std::vector<T> before(threads);
+			for (unsigned t = 1; t < threads; t++)
+				if (cut(t) != 0)
+					before[t] = src[cut(t) - 1];
+
+			parallel_for(threads, [&](unsigned t) {
+				auto b = src.begin() + cut(t), e = src.begin() + cut(t + 1);
+				if (t > 0 && cut(t) != 0)
+					while (b != e && *b == before[t])
+						++b;
+				lo[t] = b - src.begin();
+				hi[t] = std::unique(b, e) - src.begin();
+			});
+		} else {
+			std::size_t samples = std::min<std::size_t>(n, 64 * threads);
+			std::vector<T> sample(samples);
+			for (std::size_t i = 0; i < samples; i++)
+				sample[i] = src[n / samples * i];
+			std::sort(sample.begin(), sample.end());
+
+			std::vector<T> splitters(threads - 1);
+			for (unsigned b = 0; b + 1 < threads; b++)
+				splitters[b] = sample[samples * (b + 1) / threads];
+
+			auto bucket = [&](const T &key) {
+				return std::upper_bound(splitters.begin(), splitters.end(), key) - splitters.begin();
+			};
+
+			// counts[t][b]: chaves do pedaco t que vao para o balde b.
+			std::vector<std::vector<std::size_t>> counts(threads, std::vector<std::size_t>(threads));
+			parallel_for(threads, [&](unsigned t) {
+				for (std::size_t i = cut(t); i < cut(t + 1); i++)
+					counts[t][bucket(src[i])]++;
+			});
+
+			std::vector<std::vector<std::size_t>> at(threads, std::vector<std::size_t>(threads));
+			std::size_t pos = 0;
+			for (unsigned b = 0; b < threads; b++) {
+				lo[b] = pos;
+				for (unsigned t = 0; t < threads; t++) {
+					at[t][b] = pos;
+					pos += counts[t][b];
+				}
+			}
+
+			tmp.resize(n);
+			parallel_for(threads, [&](unsigned t) {
+				for (std::size_t i = cut(t); i < cut(t + 1); i++)
+					tmp[at[t][bucket(src[i])]++] = std::move(src[i]);
+			});
+
+			buf = &tmp;
+			parallel_for(threads, [&](unsigned b) {
+				std::size_t end = b + 1 < threads ? lo[b + 1] : n;
+				std::sort(tmp.begin() + lo[b], tmp.begin() + end);
+				hi[b] = std::unique(tmp.begin() + lo[b], tmp.begin() + end) - tmp.begin();
+			});
+		}
+
+		std::vector<std::size_t> out_at(threads + 1, 0);
+		for (unsigned b = 0; b < threads; b++)
+			out_at[b + 1] = out_at[b] + (hi[b] - lo[b]);
+
+		std::vector<T> keys(out_at[threads]);
+		parallel_for(threads, [&](unsigned b) {
+			std::move(buf->begin() + lo[b], buf->begin() + hi[b], keys.begin() + out_at[b]);
+		});
+		return keys;
+	}
+
+	// Distribui keys (e children, com children.size() == keys.size() + 1
+	// se nao forem folhas) em g nos com o mesmo numero de chaves (+-1).
+	// Reaproveita os nos de nodes, cria os que faltam e solta os que
+	// sobram. Devolve em nodes os g nos e em seps as g - 1 chaves entre eles.
+	void distribute(std::vector<Node*> &nodes, bool is_leaf, const std::vector<T> &keys,
+			const std::vector<Node*> &children, std::size_t g, std::vector<T> &seps) {
+		std::size_t n = keys.size();
+		std::size_t base = (n - (g - 1)) / g, extra = (n - (g - 1)) % g;
+
+		while (nodes.size() > g) {
+			drop(nodes.back());
+			nodes.pop_back();
+		}
+		while (nodes.size() < g)
+			nodes.push_back(new_node());
+
+		seps.clear();
+		std::size_t k = 0, c = 0;
+		for (std::size_t i = 0; i < g; i++) {
+			Node* node = nodes[i];
+			node->is_leaf = is_leaf;
+			node->keys.clear();
+			node->next.clear();
+
+			std::size_t cnt = base + (i < extra);
+			for (std::size_t j = 0; j < cnt; j++)
+				node->keys.push_back(keys[k++]);
+
+			if (!is_leaf) {
+				for (std::size_t j = 0; j <= cnt; j++)
+					node->next.push_back(children[c++]);
+				link_children(node);
+			}
+			recount(node);
+
+			if (i + 1 < g)
+				seps.push_back(keys[k++]);
+		}
+	}
+
+	struct batch_piece {
+		T sep;
+		Node* node;
+	};
+
+	// Insere keys (em ordem, sem repetidos) na subarvore de node, descendo
+	// uma vez so para cada filho que recebe chaves. Se node passar de 2*o
+	// chaves ele e dividido de uma vez em quantos nos precisar; os novos
+	// irmaos (a direita dele) voltam em pieces com seus separadores.
+	std::size_t batch_insert_rec(Node* node, std::span<const T> keys, std::vector<batch_piece> &pieces, std::size_t per) {
+		std::vector<T> merged;
+		std::vector<Node*> children;
+		std::size_t inserted = 0;
+
+		if (node->is_leaf) {
+			// Se cabe, insere no lugar, sem montar nada.
+			if (node->keys.size() + keys.size() <= 2 * o) {
+				for (auto &k : keys) {
+					int pos = node->find_contained(k);
+					if (pos == (int)node->keys.size() || !(node->keys[pos] == k)) {
+						node->keys.insert(node->keys.begin() + pos, k);
+						inserted++;
+					}
+				}
+				recount(node);
+				return inserted;
+			}
+
+			merged.reserve(node->keys.size() + keys.size());
+			std::set_union(node->keys.begin(), node->keys.end(), keys.begin(), keys.end(), std::back_inserter(merged));
+			inserted = merged.size() - node->keys.size();
+		} else {
+			own_children(node);
+
+			// Filhos que foram divididos, com os novos irmaos de cada um.
+			std::vector<std::pair<std::size_t, std::vector<batch_piece>>> grown;
+			std::size_t nk = node->keys.size();
+
+			for (std::size_t i = 0; i < keys.size();) {
+				std::size_t c = node->find_contained(keys[i]);
+				if (c < nk && keys[i] == node->keys[c]) {
+					i++;
+					continue;
+				}
+
+				std::size_t j = c < nk
+					? std::lower_bound(keys.begin() + i, keys.end(), node->keys[c]) - keys.begin()
+					: keys.size();
+
+				std::vector<batch_piece> sub;
+				inserted += batch_insert_rec(node->next[c], keys.subspan(i, j - i), sub, per);
+				if (!sub.empty())
+					grown.push_back({c, std::move(sub)});
+				i = j;
+			}
+
+			if (grown.empty()) {
+				recount(node);
+				return inserted;
+			}
+
+			auto g = grown.begin();
+			for (std::size_t c = 0; c <= nk; c++) {
+				children.push_back(node->next[c]);
+				if (g != grown.end() && g->first == c) {
+					for (auto &piece : g->second) {
+						merged.push_back(piece.sep);
+						children.push_back(piece.node);
+					}
+					++g;
+				}
+				if (c < nk)
+					merged.push_back(node->keys[c]);
+			}
+		}
+
+		std::size_t g = merged.size() <= 2 * o ? 1 : group_count(merged.size(), per);
+		std::vector<Node*> nodes{node};
+		std::vector<T> seps;
+		distribute(nodes, node->is_leaf, merged, children, g, seps);
+
+		for (std::size_t i = 1; i < g; i++)
+			pieces.push_back({seps[i - 1], nodes[i]});
+		return inserted;
+	}
+
+	// Junta os filhos [a, b] de node (com os separadores entre eles) e
+	// redistribui as chaves em ate b - a + 1 nos.
+	void regroup_children(Node* node, std::size_t a, std::size_t b, std::size_t per) {
+		std::vector<Node*> nodes(node->next.begin() + a, node->next.begin() + b + 1);
+		std::vector<T> keys;
+		std::vector<Node*> children;
+
+		for (std::size_t i = a; i <= b; i++) {
+			Node* child = node->next[i];
+			own_children(child);
+
+			keys.insert(keys.end(), child->keys.begin(), child->keys.end());
+			children.insert(children.end(), child->next.begin(), child->next.end());
+			if (i < b)
+				keys.push_back(node->keys[i]);
+		}
+
+		bool is_leaf = nodes.front()->is_leaf;
+		std::size_t g = std::min(group_count(keys.size(), per), nodes.size());
+		std::vector<T> seps;
+		distribute(nodes, is_leaf, keys, children, g, seps);
+
+		node->keys.erase(node->keys.begin() + a, node->keys.begin() + b);
+		node->next.erase(node->next.begin() + a, node->next.begin() + b + 1);
+		for (std::size_t i = 0; i < seps.size(); i++)
+			node->keys.insert(node->keys.begin() + a + i, seps[i]);
+		for (std::size_t i = 0; i < nodes.size(); i++)
+			node->next.insert(node->next.begin() + a + i, nodes[i]);
+
+		link_children(node);
+	}
+
+	// Cada sequencia de filhos com menos de min chaves e juntada com um
+	// vizinho e redistribuida de uma vez, da direita para a esquerda.
+	void fix_underflows(Node* node, std::size_t per, std::size_t min) {
+		std::size_t c = node->next.size();
+		while (c-- > 0) {
+			if (node->next[c]->keys.size() >= min)
+				continue;
+
+			std::size_t a = c, b = c;
+			while (a > 0 && node->next[a - 1]->keys.size() < min)
+				a--;
+
+			if (b + 1 < node->next.size())
+				b++;
+			else if (a > 0)
+				a--;
+
+			if (a == b)
+				continue;
+
+			regroup_children(node, a, b, per);
+			c = a;
+		}
+	}
+
+	// Apaga keys (em ordem, sem repetidos) da subarvore de node. As chaves
+	// que estao em nos internos vao para deferred, para serem apagadas
+	// depois com del().
+	std::size_t batch_erase_rec(Node* node, std::span<const T> keys, std::vector<T> &deferred, std::size_t per) {
+		if (node->is_leaf) {
+			std::size_t w = 0, j = 0, n = node->keys.size();
+			for (std::size_t r = 0; r < n; r++) {
+				while (j < keys.size() && keys[j] < node->keys[r])
+					j++;
+				if (j < keys.size() && keys[j] == node->keys[r]) {
+					j++;
+					continue;
+				}
+				if (w != r)
+					node->keys[w] = std::move(node->keys[r]);
+				w++;
+			}
+
+			while (node->keys.size() > w)
+				node->keys.pop_back();
+			recount(node);
+			return n - w;
+		}
+
+		own_children(node);
+
+		std::size_t nk = node->keys.size(), removed = 0;
+
+		for (std::size_t i = 0; i < keys.size();) {
+			std::size_t c = node->find_contained(keys[i]);
+			if (c < nk && keys[i] == node->keys[c]) {
+				deferred.push_back(keys[i++]);
+				continue;
+			}
+
+			std::size_t j = c < nk
+				? std::lower_bound(keys.begin() + i, keys.end(), node->keys[c]) - keys.begin()
+				: keys.size();
+
+			removed += batch_erase_rec(node->next[c], keys.subspan(i, j - i), deferred, per);
+			i = j;
+		}
+
+		if (removed)
+			fix_underflows(node, per, min_keys);
+		recount(node);
+		return removed;
+	}
+
+	// Um passo da compactacao: desce pela chave key (nullptr: a menor) ate
+	// o no logo acima das folhas e, de baixo para cima, junta e redistribui
+	// os filhos com menos de o chaves de cada no do caminho. Em next fica
+	// a chave do ancestral logo a direita da subarvore compactada, de onde
+	// o proximo passo continua (vazio se ela era a ultima).
+	void compact_rec(Node* node, const T* key, std::optional<T> &next) {
+		own_children(node);
+
+		int pos = key ? node->find_next(*key) : 0;
+		if (pos < (int)node->keys.size())
+			next = node->keys[pos];
+
+		if (!node->next[pos]->is_leaf)
+			compact_rec(node->next[pos], key, next);
+
+		fix_underflows(node, 2 * o, o);
+		recount(node);
+	}
+
+public:
+	using node_type = Node;
+
+	// Iterador bidirecional em ordem crescente. Guarda o caminho desde a
+	// raiz (os vizinhos so ligam irmaos do mesmo pai), entao avancar custa
+	// O(1) amortizado sem voltar a descer da raiz. Qualquer insert/del
+	// invalida os iteradores.
+	class const_iterator {
+		friend class BTree;
+
+		// No ultimo frame index e a chave atual; nos de cima, o filho
+		// por onde o caminho desceu (a chave seguinte a ele e keys[index]).
+		struct frame {
+			const Node* node;
+			int index;
+		};
+
+		std::vector<frame> path;
+		const Node* root = nullptr;
+
+		explicit const_iterator(const Node* root) : root(root) {}
+
+		void push_leftmost(const Node* node) {
+			while (true) {
+				path.push_back({node, 0});
+				if (node->is_leaf)
+					return;
+				node = node->next[0];
+			}
+		}
+
+		void push_rightmost(const Node* node) {
+			while (!node->is_leaf) {
+				path.push_back({node, (int)node->next.size() - 1});
+				node = node->next.back();
+			}
+			path.push_back({node, (int)node->keys.size() - 1});
+		}
+
+		// Sobe enquanto o frame do topo ja passou da ultima chave.
+		void skip_exhausted() {
+			while (!path.empty() && path.back().index == (int)path.back().node->keys.size())
+				path.pop_back();
+		}
+
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const T*;
+		using reference = const T&;
+
+		const_iterator() = default;
+
+		reference operator*() const {
+			return path.back().node->keys[path.back().index];
+		}
+
+		pointer operator->() const {
+			return &**this;
+		}
+
+		const_iterator& operator++() {
+			auto &f = path.back();
+
+			if (!f.node->is_leaf) {
+				f.index++;
+				push_leftmost(f.node->next[f.index]);
+				return *this;
+			}
+
+			f.index++;
+			skip_exhausted();
+			return *this;
+		}
+
+		const_iterator operator++(int) {
+			auto copy = *this;
+			++*this;
+			return copy;
+		}
+
+		const_iterator& operator--() {
+			if (path.empty()) {
+				push_rightmost(root);
+				return *this;
+			}
+
+			auto &f = path.back();
+
+			if (!f.node->is_leaf) {
+				push_rightmost(f.node->next[f.index]);
+				return *this;
+			}
+
+			if (f.index > 0) {
+				f.index--;
+				return *this;
+			}
+
+			path.pop_back();
+			while (!path.empty() && path.back().index == 0)
+				path.pop_back();
+			if (!path.empty())
+				path.back().index--;
+			return *this;
+		}
+
+		const_iterator operator--(int) {
+			auto copy = *this;
+			--*this;
+			return copy;
+		}
+
+		bool operator==(const const_iterator &other) const {
+			if (path.empty() || other.path.empty())
+				return path.empty() && other.path.empty();
+			return path.back().node == other.path.back().node && path.back().index == other.path.back().index;
+		}
+	};
+
+	using iterator = const_iterator;
+
+private:
+	static const_iterator begin_from(const Node* root) {
+		const_iterator it(root);
+		if (root->keys.size())
+			it.push_leftmost(root);
+		return it;
+	}
+
+	static const_iterator lower_bound_from(const Node* root, const T &key) {
+		const_iterator it(root);
+		const Node* node = root;
+
+		while (true) {
+			int i = node->find_contained(key);
+			it.path.push_back({node, i});
+
+			if (i < (int)node->keys.size() && node->keys[i] == key)
+				return it;
+			if (node->is_leaf)
+				break;
+			node = node->next[i];
+		}
+
+		it.skip_exhausted();
+		return it;
+	}
+
+	static const_iterator upper_bound_from(const Node* root, const T &key) {
+		const_iterator it(root);
+		const Node* node = root;
+
+		while (true) {
+			int i = node->find_next(key);
+			it.path.push_back({node, i});
+
+			if (node->is_leaf)
+				break;
+			node = node->next[i];
+		}
+
+		it.skip_exhausted();
+		return it;
+	}
+
+	static std::size_t rank_from(const Node* node, const T &key) {
+		std::size_t rank = 0;
+
+		while (true) {
+			int pos = node->find_contained(key);
+			rank += pos;
+			if (!node->is_leaf)
+				for (int i = 0; i < pos; i++)
+					rank += node->counts.child[i];
+
+			bool found = pos < (int)node->keys.size() && node->keys[pos] == key;
+			if (node->is_leaf)
+				return rank;
+			if (found)
+				return rank + node->counts.child[pos];
+			node = node->next[pos];
+		}
+	}
+
+	static const T& select_from(const Node* node, std::size_t k) {
+		while (!node->is_leaf) {
+			std::size_t i = 0;
+			while (k >= node->counts.child[i]) {
+				k -= node->counts.child[i];
+				if (k == 0)
+					return node->keys[i];
+				k--;
+				i++;
+			}
+			node = node->next[i];
+		}
+		return node->keys[k];
+	}
+
+public:
+	// Visao somente leitura da arvore como ela estava quando snapshot() foi
+	// chamado. Os nos que ela enxerga nao sao mais alterados pelo escritor,
+	// entao pode ser lida (e destruida) em outra thread sem travar nada,
+	// enquanto a arvore continua recebendo insert/del. Nao pode viver mais
+	// que a arvore.
+	class Snapshot {
+		friend class BTree;
+
+		std::shared_ptr<snapshot_registry> registry;
+		const Node* root = nullptr;
+		std::uint64_t epoch = 0;
+
+		Snapshot(std::shared_ptr<snapshot_registry> registry, const Node* root, std::uint64_t epoch)
+			: registry(std::move(registry)), root(root), epoch(epoch) {}
+
+	public:
+		Snapshot() = default;
+
+		Snapshot(Snapshot &&other) noexcept
+			: registry(std::move(other.registry)), root(other.root), epoch(other.epoch) {}
+
+		Snapshot& operator=(Snapshot &&other) noexcept {
+			release();
+			registry = std::move(other.registry);
+			root = other.root;
+			epoch = other.epoch;
+			return *this;
+		}
+
+		~Snapshot() {
+			release();
+		}
+
+		// Solta os nos do snapshot; a arvore os libera no proximo insert/del.
+		void release() {
+			if (registry) {
+				registry->remove(epoch);
+				registry.reset();
+			}
+		}
+
+		bool find(const T &key) const {
+			return find_rec(root, key);
+		}
+
+		const_iterator begin() const {
+			return begin_from(root);
+		}
+
+		const_iterator end() const {
+			return const_iterator(root);
+		}
+
+		const_iterator lower_bound(const T &key) const {
+			return lower_bound_from(root, key);
+		}
+
+		const_iterator upper_bound(const T &key) const {
+			return upper_bound_from(root, key);
+		}
+
+		template<class F>
+		void for_each_in_range(const T &lo, const T &hi, F fn) const {
+			range_rec(root, lo, hi, fn);
+		}
+
+		std::size_t size() const requires Ranked {
+			return root->counts.total;
+		}
+
+		std::size_t rank(const T &key) const requires Ranked {
+			return rank_from(root, key);
+		}
+
+		const T& select(std::size_t k) const requires Ranked {
+			return select_from(root, k);
+		}
+	};
+
+	bool find(const T &key) {
+#ifdef BTREE_STATS
+		counters.lookups++;
+		if (filtered_out(key)) {
+			counters.filter_rejects++;
+			return false;
+		}
+		for (const Node* node = root; ; node = node->next[node->find_next(key)]) {
+			counters.lookup_nodes++;
+			if (node->contains(key))
+				return true;
+			if (node->is_leaf)
+				return false;
+		}
+#else
+		if (filtered_out(key))
+			return false;
+		return find_rec(root, key);
+#endif
+	}
+
+	// Como find, mas const e sem os contadores de BTREE_STATS: varias
+	// threads podem chamar ao mesmo tempo, desde que nenhuma altere a
+	// arvore.
+	bool contains(const T &key) const {
+		return !filtered_out(key) && find_rec(root, key);
+	}
+
+	// Liga um filtro de Bloom com todas as chaves (bits_per_key bits por
+	// chave) que find, find_batch e del consultam antes de descer: uma
+	// chave ausente e quase sempre descartada com um cache miss, em vez de
+	// um por nivel. Continua correto com insert/del e as operacoes em lote.
+	// Custa uns bits_per_key / 4 bytes por chave e um rebuild de vez em
+	// quando. Os snapshots nao usam o filtro.
+	void enable_filter(double bits_per_key = 10) requires bloom_hashable<T> {
+		filter_bits = bits_per_key;
+		filter = std::make_unique<bloom_filter<T>>(1, bits_per_key);
+		rebuild_filter();
+	}
+
+	void disable_filter() {
+		filter.reset();
+	}
+
+	// Liga o insert pelo dedo, para chaves em sequencia ou agrupadas
+	// (timestamps, ids crescentes): a arvore guarda o caminho ate a folha
+	// do ultimo insert, e o proximo sobe por ele so ate onde a chave cabe e
+	// desce dali, em vez de descer da raiz. Inserir sempre na borda
+	// direita fica O(1) amortizado: a descida inteira so acontece depois
+	// de um split. Com chaves espalhadas custa algumas comparacoes a mais.
+	void enable_finger() {
+		finger_on = true;
+	}
+
+	void disable_finger() {
+		finger_on = false;
+		finger.clear();
+	}
+
+	// Ocupacao minima no del. Por padrao um no que fica com menos de o
+	// chaves pega uma emprestada de um vizinho ou e juntado com ele na
+	// hora, o que oscila quando insert e del se alternam perto do limite.
+	// Com min_keys menor os nos podem esvaziar ate min_keys (bottom_up) ou
+	// min_keys - 1 (top_down) antes disso; 0 rebalanceia so quando o no
+	// ficaria vazio. O del fica mais barato e previsivel e a arvore ocupa
+	// no pior caso uns o / min_keys vezes mais nos.
+	//
+	// Com compact_every > 0, cada compact_every dels fazem tambem um
+	// compact_step(), e a ocupacao volta para perto de o aos poucos.
+	void set_min_fill(std::size_t min_keys, std::size_t compact_every = 0) {
+		std::size_t floor = std::is_same_v<Updates, top_down> ? 2 : 1;
+		this->min_keys = std::clamp<std::size_t>(min_keys, floor, o);
+		this->compact_every = compact_every;
+		dels_since_compact = 0;
+	}
+
+	// Um passo da compactacao incremental: junta e redistribui os filhos
+	// com menos de o chaves abaixo de um dos nos logo acima das folhas (e
+	// nos ancestrais dele), em O(o^2 log n). Os passos andam da esquerda
+	// para a direita; devolve false quando uma passada pela arvore termina
+	// (o proximo recomeca do inicio). Pode ser chamado quando a aplicacao
+	// estiver ociosa, ou deixado para o del (set_min_fill).
+	bool compact_step() {
+		refresh_shared();
+		own_root();
+
+		if (root->is_leaf) {
+			compact_cursor.reset();
+			return false;
+		}
+
+		std::optional<T> next;
+		compact_rec(root, compact_cursor ? &*compact_cursor : nullptr, next);
+		while (root->keys.size() == 0 && root->next.size() == 1)
+			shrink_root();
+
+		compact_cursor = std::move(next);
+		maybe_reclaim();
+		return compact_cursor.has_value();
+	}
+
+	// Uma passada inteira de compact_step(): depois dela os nos voltam a
+	// ter pelo menos o chaves.
+	void compact() {
+		compact_cursor.reset();
+		while (compact_step())
+			;
+	}
+
+	// Contadores acumulados (so com BTREE_STATS) mais a forma atual da
+	// arvore: altura, ocupacao por nivel e memoria. Percorre a arvore toda.
+	btree_stats stats() const {
+		btree_stats s;
+#ifdef BTREE_STATS
+		s = counters;
+#endif
+
+		std::vector<const Node*> level{root}, below;
+		while (!level.empty()) {
+			btree_stats::level l;
+			for (auto node : level) {
+				l.nodes++;
+				l.keys += node->keys.size();
+				l.fill[std::min<std::size_t>(9, node->keys.size() * 10 / (2 * o))]++;
+				s.bytes += node_bytes(node);
+				below.insert(below.end(), node->next.begin(), node->next.end());
+			}
+
+			s.nodes += l.nodes;
+			s.levels.push_back(l);
+			level.swap(below);
+			below.clear();
+		}
+		s.height = s.levels.size();
+		if (filter)
+			s.filter_bytes = filter->memory_usage();
+
+		for (auto r : retired)
+			s.bytes += node_bytes(r.node);
+		return s;
+	}
+
+	void reset_stats() {
+#ifdef BTREE_STATS
+		counters = {};
+#endif
+	}
+
+	BTree() {
+		root = new_node();
+	}
+    
+	void clear() {
+		release_tree();
+		root = new_node();
+		rebuild_filter();
+	}
+
+	~BTree() {
+		destroy_all();
+	}
+
+	bool insert(const T &key) {
+		return insert_one(key);
+	}
+
+	// Move key para dentro da arvore em vez de copiar.
+	bool insert(T &&key) {
+		return insert_one(std::move(key));
+	}
+
+	// Constroi a chave com args e a move para a arvore (se ela ja existir,
+	// a construida e descartada).
+	template<class... Args>
+	bool emplace(Args&&... args) {
+		return insert_one(T(std::forward<Args>(args)...));
+	}
+
+
+	bool del(const T&key) {
+		if (filtered_out(key))
+			return false;
+
+		refresh_shared();
+
+		if (shared_upto != 0 && !find_rec(root, key))
+			return false;
+
+		own_root();
+
+		bool deleted;
+		if constexpr (std::is_same_v<Updates, top_down>) {
+			deleted = delete_top_down(key);
+		} else {
+			auto res = delete_rec(root, key);		
+
+			shrink_root();
+			recount(root);
+			deleted = res.deleted;
+		}
+
+		maybe_reclaim();
+		if (deleted) {
+			filter_update(0, 1);
+			if (compact_every && ++dels_since_compact >= compact_every) {
+				dels_since_compact = 0;
+				compact_step();
+			}
+		}
+		return deleted;
+	}
+
+	// Snapshot da versao atual, em O(1): dai em diante insert/del copiam os
+	// nos que alteram (o caminho ate a folha e os irmaos de cada no do
+	// caminho, por causa dos ponteiros de vizinho) em vez de altera-los.
+	// Sem snapshots vivos nada e copiado. Tem que ser chamado pela mesma
+	// thread que faz insert/del.
+	Snapshot snapshot() {
+		if (!snapshots)
+			snapshots = std::make_shared<snapshot_registry>();
+
+		std::uint64_t e = version++;
+		snapshots->add(e);
+		shared_upto = e;
+		return Snapshot(snapshots, root, e);
+	}
+
+	const_iterator begin() const {
+		return begin_from(root);
+	}
+
+	const_iterator end() const {
+		return const_iterator(root);
+	}
+
+	// Copia as chaves para uma FrozenBTree (so leitura, sem ponteiros, ver
+	// frozen_btree.hpp), para tabelas que nao mudam mais depois de montadas.
+	// A arvore continua valendo; se nao for mais usada, clear() a libera.
+	template<int B = frozen_block<T>()>
+	FrozenBTree<T, B> freeze() const {
+		return FrozenBTree<T, B>(begin(), end());
+	}
+
+	// found[i] = find(keys[i]). As buscas andam em grupos, um nivel por vez:
+	// cada uma desce um nivel e ja pede o proximo no com prefetch, entao os
+	// cache misses de chaves diferentes se sobrepoem em vez de acontecerem
+	// um depois do outro. found precisa ter pelo menos keys.size() posicoes.
+	void find_batch(std::span<const T> keys, std::span<bool> found) const {
+		constexpr std::size_t group = 16;
+		const Node* cur[group];
+
+		for (std::size_t base = 0; base < keys.size(); base += group) {
+			std::size_t n = std::min(group, keys.size() - base);
+
+			for (std::size_t i = 0; i < n; i++) {
+				cur[i] = root;
+				if (filtered_out(keys[base + i])) {
+					found[base + i] = false;
+					cur[i] = nullptr;
+				}
+			}
+
+			std::size_t active = n;
+			while (active) {
+				active = 0;
+
+				for (std::size_t i = 0; i < n; i++) {
+					const Node* node = cur[i];
+					if (node == nullptr)
+						continue;
+
+					const T &key = keys[base + i];
+					int pos = node->find_contained(key);
+
+					if (pos < (int)node->keys.size() && node->keys[pos] == key) {
+						found[base + i] = true;
+						cur[i] = nullptr;
+					} else if (node->is_leaf) {
+						found[base + i] = false;
+						cur[i] = nullptr;
+					} else {
+						cur[i] = node->next[pos];
+						prefetch_node(cur[i]);
+						active++;
+					}
+				}
+			}
+		}
+	}
+
+	// Primeira chave >= key.
+	const_iterator lower_bound(const T &key) const {
+		return lower_bound_from(root, key);
+	}
+
+	// Primeira chave > key.
+	const_iterator upper_bound(const T &key) const {
+		return upper_bound_from(root, key);
+	}
+
+	// Chama fn(key) em ordem para cada chave em [lo, hi).
+	template<class F>
+	void for_each_in_range(const T &lo, const T &hi, F fn) const {
+		range_rec(root, lo, hi, fn);
+	}
+
+	// So com Ranked. size() e o numero de chaves; rank(key) quantas chaves
+	// sao menores que key; select(k) a k-esima menor chave (a partir de 0,
+	// k < size()). Todos em O(log n).
+	std::size_t size() const requires Ranked {
+		return root->counts.total;
+	}
+
+	std::size_t rank(const T &key) const requires Ranked {
+		return rank_from(root, key);
+	}
+
+	const T& select(std::size_t k) const requires Ranked {
+		return select_from(root, k);
+	}
+
+	// Reconstroi a arvore a partir de [first, last), que precisa estar em
+	// ordem crescente (repetidos sao ignorados). As folhas sao montadas ja
+	// cheias e os niveis internos por cima delas, sem passar pelo insert.
+	// fill e a fracao de 2*o chaves que cada no recebe (nunca menos que o),
+	// para deixar espaco para insercoes futuras sem split imediato.
+	// Devolve false, sem mexer na arvore, se a entrada nao estiver ordenada.
+	template<std::input_iterator It>
+	bool bulk_load(It first, It last, double fill = 1.0) {
+		std::vector<T> keys(first, last);
+
+		for (std::size_t i = 1; i < keys.size(); i++)
+			if (keys[i] < keys[i - 1])
+				return false;
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+		std::size_t per = std::clamp<std::size_t>(std::lround(fill * 2 * o), o, 2 * o);
+
+		release_tree();
+
+		std::vector<Node*> level = build_level({}, keys, per);
+		while (level.size() > 1)
+			level = build_level(level, keys, per);
+
+		root = level.front();
+		rebuild_filter();
+		return true;
+	}
+
+	// Como bulk_load, mas com threads threads e aceitando entrada fora de
+	// ordem: a entrada e ordenada em paralelo e cada nivel e dividido em
+	// trechos de nos consecutivos, um por thread, cada uma alocando num
+	// Alloc proprio que depois e juntado ao da arvore. Como os vizinhos sao
+	// so entre irmaos e cada no liga os seus filhos, os trechos nao tem o
+	// que acertar entre si; o resultado e o mesmo do bulk_load. Devolve
+	// quantas chaves (distintas) a arvore ficou.
+	template<std::random_access_iterator It>
+	std::size_t parallel_build(It first, It last, unsigned threads = std::thread::hardware_concurrency(), double fill = 1.0) {
+		std::size_t n = last - first;
+
+		// Abaixo de uns milhares de chaves por thread nao compensa.
+		threads = (unsigned)std::clamp<std::size_t>(std::min<std::size_t>(threads, n / 4096), 1, 1024);
+
+		std::vector<T> keys = parallel_sort_unique(first, n, threads);
+		std::size_t count = keys.size();
+
+		std::size_t per = std::clamp<std::size_t>(std::lround(fill * 2 * o), o, 2 * o);
+
+		release_tree();
+
+		auto allocs = std::make_unique<Alloc<Node>[]>(threads);
+		std::vector<Node*> level;
+		do {
+			std::size_t g = group_count(keys.size(), per);
+			unsigned parts = (unsigned)std::min<std::size_t>(threads, g / 64 + 1);
+
+			std::vector<Node*> next_level(g);
+			std::vector<T> up(g - 1);
+			parallel_for(parts, [&](unsigned t) {
+				build_groups(level, keys, g, g * t / parts, g * (t + 1) / parts, next_level, up,
+					t == 0 ? alloc : allocs[t]);
+			});
+
+			level = std::move(next_level);
+			keys = std::move(up);
+		} while (level.size() > 1);
+
+		for (unsigned t = 1; t < threads; t++)
+			alloc.adopt(allocs[t]);
+
+		root = level.front();
+		rebuild_filter();
+		return count;
+	}
+
+	// Insere as chaves de [first, last) descendo uma vez so para cada folha
+	// que recebe chaves (em vez de uma descida por chave). Nos que passam de
+	// 2*o chaves sao divididos de uma vez, com fill como no bulk_load. A
+	// entrada deve estar em ordem; se nao estiver, e ordenada antes.
+	// Devolve quantas chaves foram inseridas.
+	template<std::input_iterator It>
+	std::size_t insert_sorted_batch(It first, It last, double fill = 1.0) {
+		std::vector<T> keys(first, last);
+		if (!std::is_sorted(keys.begin(), keys.end()))
+			std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+		std::size_t per = std::clamp<std::size_t>(std::lround(fill * 2 * o), o, 2 * o);
+
+		for (auto &k : keys)
+			filter_add(k);
+
+		refresh_shared();
+		own_root();
+
+		std::vector<batch_piece> pieces;
+		std::size_t inserted = batch_insert_rec(root, keys, pieces, per);
+
+		if (!pieces.empty()) {
+			std::vector<Node*> level{root};
+			std::vector<T> seps;
+			for (auto &piece : pieces) {
+				seps.push_back(piece.sep);
+				level.push_back(piece.node);
+			}
+
+			while (level.size() > 1)
+				level = build_level(level, seps, per);
+			root = level.front();
+		}
+
+		maybe_reclaim();
+		filter_update(inserted, 0);
+		return inserted;
+	}
+
+	// Apaga as chaves de [first, last), uma descida por folha. Os filhos que
+	// ficam com menos de o chaves sao juntados com um vizinho e
+	// redistribuidos de uma vez. Chaves que estao em nos internos sao
+	// apagadas no fim com del(). Devolve quantas chaves foram apagadas.
+	template<std::input_iterator It>
+	std::size_t erase_sorted_batch(It first, It last, double fill = 1.0) {
+		std::vector<T> keys(first, last);
+		if (!std::is_sorted(keys.begin(), keys.end()))
+			std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+		std::size_t per = std::clamp<std::size_t>(std::lround(fill * 2 * o), o, 2 * o);
+
+		refresh_shared();
+		own_root();
+
+		std::vector<T> deferred;
+		std::size_t removed = batch_erase_rec(root, keys, deferred, per);
+
+		while (root->keys.size() == 0 && root->next.size() == 1)
+			shrink_root();
+		filter_update(0, removed);
+
+		for (auto &k : deferred)
+			removed += del(k);
+
+		maybe_reclaim();
+		return removed;
+	}
+
+	void print() {
+
+		print_rec(root);
+
+	}
+};
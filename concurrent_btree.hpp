@@ -0,0 +1,496 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "node_search.hpp"
+
+// Reclamacao de memoria por epocas. Cada operacao na arvore roda dentro de
+// um epoch_manager::guard, que anuncia a epoca global do momento em que
+// entrou. Um no removido da arvore vai para a lista de retirados marcado
+// com a epoca atual e so e liberado quando nenhuma thread ativa anunciou
+// uma epoca menor ou igual a dele: quem entrou depois nao tem como chegar
+// no no, e quem entrou antes ainda pode estar lendo.
+class epoch_manager {
+	static constexpr std::size_t max_threads = 256;
+	static constexpr std::uint64_t idle = UINT64_MAX;
+	static constexpr std::size_t reclaim_every = 64;
+
+	struct alignas(64) slot {
+		std::atomic<bool> used{false};
+		std::atomic<std::uint64_t> epoch{idle};
+	};
+
+	struct retired_ptr {
+		std::uint64_t epoch;
+		void* ptr;
+		void (*free)(void*);
+	};
+
+	std::atomic<std::uint64_t> global{1};
+	slot slots[max_threads];
+
+	std::mutex retired_mutex;
+	std::vector<retired_ptr> retired;
+
+	std::uint64_t min_active() {
+		std::uint64_t m = idle;
+		for (auto &s : slots)
+			m = std::min(m, s.epoch.load());
+		return m;
+	}
+
+	// Chamado com retired_mutex travado.
+	void reclaim() {
+		global.fetch_add(1);
+		std::uint64_t m = min_active();
+
+		auto keep = std::partition(retired.begin(), retired.end(),
+			[&](const retired_ptr &r) { return r.epoch >= m; });
+		for (auto it = keep; it != retired.end(); ++it)
+			it->free(it->ptr);
+		retired.erase(keep, retired.end());
+	}
+
+public:
+	class guard {
+		slot* s;
+
+	public:
+		explicit guard(epoch_manager &em) {
+			std::size_t i = std::hash<std::thread::id>{}(std::this_thread::get_id()) % max_threads;
+			while (true) {
+				bool expected = false;
+				if (!em.slots[i].used.load(std::memory_order_relaxed) &&
+				    em.slots[i].used.compare_exchange_strong(expected, true))
+					break;
+				i = (i + 1) % max_threads;
+			}
+			s = &em.slots[i];
+			s->epoch.store(em.global.load());
+		}
+
+		~guard() {
+			s->epoch.store(idle);
+			s->used.store(false, std::memory_order_release);
+		}
+
+		guard(const guard &) = delete;
+		guard& operator=(const guard &) = delete;
+	};
+
+	epoch_manager() = default;
+	epoch_manager(const epoch_manager &) = delete;
+	epoch_manager& operator=(const epoch_manager &) = delete;
+
+	~epoch_manager() {
+		for (auto &r : retired)
+			r.free(r.ptr);
+	}
+
+	// ptr ja precisa estar inalcancavel para quem entrar daqui para frente.
+	template<class P>
+	void retire(P* ptr) {
+		std::lock_guard lock(retired_mutex);
+		retired.push_back({global.load(), ptr, [](void* p) { delete static_cast<P*>(p); }});
+		if (retired.size() >= reclaim_every)
+			reclaim();
+	}
+};
+
+
+// B-tree concorrente com optimistic lock coupling (Leis et al., "The ART
+// of Practical Synchronization"). Cada no tem um contador de versao:
+// leitores nao travam nada, leem o no e conferem que a versao nao mudou
+// antes de confiar no que leram, recomecando da raiz se mudou. Escritores
+// so travam os nos que vao alterar (a folha e, num split, o pai).
+//
+// Para que um insert ou erase altere so uma folha, as chaves ficam todas
+// nas folhas e os nos internos guardam apenas separadores (layout B+).
+// Nos cheios sao divididos ja na descida, entao o pai sempre tem espaco
+// para o separador. O erase nao faz merge; so uma folha que fica vazia e
+// removida do pai, e a memoria dela e devolvida pelo epoch_manager.
+//
+// Como leitores podem ler um no no meio de uma escrita e so depois
+// descartar o resultado, T precisa ser trivialmente copiavel.
+template <class T, int o>
+class ConcurrentBTree {
+	static_assert(std::is_trivially_copyable_v<T>, "ConcurrentBTree precisa de chaves trivialmente copiaveis");
+	static_assert(o >= 1);
+
+	static constexpr int max_keys = 2 * o;
+
+	// Bit 0: no obsoleto (saiu da arvore). Bit 1: travado para escrita.
+	// Cada escrita soma 2 ao destravar, mudando a versao.
+	struct node_base {
+		std::atomic<std::uint64_t> version{0};
+		bool is_leaf;
+		std::uint16_t count = 0;
+
+		explicit node_base(bool is_leaf) : is_leaf(is_leaf) {}
+
+		int size() const {
+			// Um leitor otimista pode ver count no meio de uma escrita.
+			return std::min<int>(count, max_keys);
+		}
+
+		bool read_lock(std::uint64_t &v) const {
+			v = version.load();
+			return (v & 3) == 0;
+		}
+
+		bool validate(std::uint64_t v) const {
+			return version.load() == v;
+		}
+
+		bool upgrade(std::uint64_t v) {
+			return version.compare_exchange_strong(v, v + 2);
+		}
+
+		void write_unlock() {
+			version.fetch_add(2);
+		}
+
+		void write_unlock_obsolete() {
+			version.fetch_add(3);
+		}
+	};
+
+	struct leaf : node_base {
+		T keys[max_keys];
+
+		leaf() : node_base(true) {}
+
+		// Primeira posicao com chave >= key.
+		int lower_bound(const T &key) const {
+			return node_search::count_less(keys, this->size(), key);
+		}
+
+		bool insert(const T &key) {
+			int pos = lower_bound(key);
+			if (pos < this->count && keys[pos] == key)
+				return false;
+
+			std::move_backward(keys + pos, keys + this->count, keys + this->count + 1);
+			keys[pos] = key;
+			this->count++;
+			return true;
+		}
+
+		bool erase(const T &key) {
+			int pos = lower_bound(key);
+			if (pos == this->count || !(keys[pos] == key))
+				return false;
+
+			std::move(keys + pos + 1, keys + this->count, keys + pos);
+			this->count--;
+			return true;
+		}
+
+		// Metade de cima vai para o novo no; sep e a maior chave que fica.
+		leaf* split(T &sep) {
+			leaf* right = new leaf();
+			int half = this->count / 2;
+
+			std::copy(keys + half, keys + this->count, right->keys);
+			right->count = this->count - half;
+			this->count = half;
+
+			sep = keys[half - 1];
+			return right;
+		}
+	};
+
+	// O filho i guarda as chaves em (keys[i-1], keys[i]].
+	struct inner : node_base {
+		T keys[max_keys];
+		node_base* children[max_keys + 1];
+
+		inner() : node_base(false) {}
+
+		int lower_bound(const T &key) const {
+			return node_search::count_less(keys, this->size(), key);
+		}
+
+		void insert(const T &sep, node_base* right) {
+			int pos = lower_bound(sep);
+			std::move_backward(keys + pos, keys + this->count, keys + this->count + 1);
+			std::move_backward(children + pos + 1, children + this->count + 1, children + this->count + 2);
+			keys[pos] = sep;
+			children[pos + 1] = right;
+			this->count++;
+		}
+
+		void remove_child(int pos) {
+			int key_pos = pos < this->count ? pos : pos - 1;
+			std::move(keys + key_pos + 1, keys + this->count, keys + key_pos);
+			std::move(children + pos + 1, children + this->count + 1, children + pos);
+			this->count--;
+		}
+
+		inner* split(T &sep) {
+			inner* right = new inner();
+			int right_count = this->count - this->count / 2;
+			int left_count = this->count - right_count - 1;
+
+			std::copy(keys + left_count + 1, keys + this->count, right->keys);
+			std::copy(children + left_count + 1, children + this->count + 1, right->children);
+			right->count = right_count;
+
+			sep = keys[left_count];
+			this->count = left_count;
+			return right;
+		}
+	};
+
+	std::atomic<node_base*> root;
+	mutable epoch_manager epochs;
+
+	static void free_node(node_base* node) {
+		if (node->is_leaf)
+			delete static_cast<leaf*>(node);
+		else
+			delete static_cast<inner*>(node);
+	}
+
+	void free_rec(node_base* node) {
+		if (!node->is_leaf) {
+			auto in = static_cast<inner*>(node);
+			for (int i = 0; i <= in->count; i++)
+				free_rec(in->children[i]);
+		}
+		free_node(node);
+	}
+
+	void make_root(const T &sep, node_base* left, node_base* right) {
+		inner* r = new inner();
+		r->keys[0] = sep;
+		r->children[0] = left;
+		r->children[1] = right;
+		r->count = 1;
+		root.store(r);
+	}
+
+	enum class outcome { done_true, done_false, restart };
+
+	outcome try_find(const T &key) const {
+		std::uint64_t v;
+		node_base* node = root.load();
+		if (!node->read_lock(v) || node != root.load())
+			return outcome::restart;
+
+		while (!node->is_leaf) {
+			auto in = static_cast<inner*>(node);
+			node_base* child = in->children[in->lower_bound(key)];
+			if (!in->validate(v))
+				return outcome::restart;
+
+			std::uint64_t child_v;
+			if (!child->read_lock(child_v))
+				return outcome::restart;
+
+			// Um split de child entre o validate acima e o read_lock pode
+			// ter levado key para o irmao novo: o pai so e solto depois de
+			// conferido de novo.
+			if (!in->validate(v))
+				return outcome::restart;
+
+			node = child;
+			v = child_v;
+		}
+
+		auto lf = static_cast<leaf*>(node);
+		int pos = lf->lower_bound(key);
+		bool found = pos < lf->size() && lf->keys[pos] == key;
+
+		if (!lf->validate(v))
+			return outcome::restart;
+		return found ? outcome::done_true : outcome::done_false;
+	}
+
+	// Divide node (cheio) travando ele e o pai. Sempre pede restart depois.
+	template<class N>
+	outcome split_full(N* node, std::uint64_t v, inner* parent, std::uint64_t parent_v) {
+		if (parent != nullptr && !parent->upgrade(parent_v))
+			return outcome::restart;
+
+		if (!node->upgrade(v)) {
+			if (parent != nullptr)
+				parent->write_unlock();
+			return outcome::restart;
+		}
+
+		// Sem pai, node precisa continuar sendo a raiz.
+		if (parent == nullptr && node != root.load()) {
+			node->write_unlock();
+			return outcome::restart;
+		}
+
+		T sep;
+		N* right = node->split(sep);
+		if (parent != nullptr)
+			parent->insert(sep, right);
+		else
+			make_root(sep, node, right);
+
+		node->write_unlock();
+		if (parent != nullptr)
+			parent->write_unlock();
+		return outcome::restart;
+	}
+
+	outcome try_insert(const T &key) {
+		std::uint64_t v;
+		node_base* node = root.load();
+		if (!node->read_lock(v) || node != root.load())
+			return outcome::restart;
+
+		inner* parent = nullptr;
+		std::uint64_t parent_v = 0;
+
+		while (!node->is_leaf) {
+			auto in = static_cast<inner*>(node);
+
+			if (in->count == max_keys)
+				return split_full(in, v, parent, parent_v);
+
+			if (parent != nullptr && !parent->validate(parent_v))
+				return outcome::restart;
+
+			parent = in;
+			parent_v = v;
+
+			node_base* child = in->children[in->lower_bound(key)];
+			if (!in->validate(v))
+				return outcome::restart;
+			if (!child->read_lock(v))
+				return outcome::restart;
+			node = child;
+		}
+
+		auto lf = static_cast<leaf*>(node);
+
+		if (lf->count == max_keys)
+			return split_full(lf, v, parent, parent_v);
+
+		if (!lf->upgrade(v))
+			return outcome::restart;
+		if (parent != nullptr && !parent->validate(parent_v)) {
+			lf->write_unlock();
+			return outcome::restart;
+		}
+
+		bool inserted = lf->insert(key);
+		lf->write_unlock();
+		return inserted ? outcome::done_true : outcome::done_false;
+	}
+
+	outcome try_erase(const T &key) {
+		std::uint64_t v;
+		node_base* node = root.load();
+		if (!node->read_lock(v) || node != root.load())
+			return outcome::restart;
+
+		inner* parent = nullptr;
+		std::uint64_t parent_v = 0;
+		int child_pos = 0;
+
+		while (!node->is_leaf) {
+			auto in = static_cast<inner*>(node);
+
+			if (parent != nullptr && !parent->validate(parent_v))
+				return outcome::restart;
+
+			parent = in;
+			parent_v = v;
+
+			child_pos = in->lower_bound(key);
+			node_base* child = in->children[child_pos];
+			if (!in->validate(v))
+				return outcome::restart;
+			if (!child->read_lock(v))
+				return outcome::restart;
+			node = child;
+		}
+
+		auto lf = static_cast<leaf*>(node);
+
+		// Folha com uma chave so: se for a chave apagada, a folha sai do
+		// pai (que precisa ficar com pelo menos um filho).
+		if (lf->count == 1 && parent != nullptr && parent->count > 0) {
+			if (!parent->upgrade(parent_v))
+				return outcome::restart;
+			if (!lf->upgrade(v)) {
+				parent->write_unlock();
+				return outcome::restart;
+			}
+
+			if (!lf->erase(key)) {
+				lf->write_unlock();
+				parent->write_unlock();
+				return outcome::done_false;
+			}
+
+			parent->remove_child(child_pos);
+			lf->write_unlock_obsolete();
+			parent->write_unlock();
+			epochs.retire(lf);
+			return outcome::done_true;
+		}
+
+		if (!lf->upgrade(v))
+			return outcome::restart;
+		if (parent != nullptr && !parent->validate(parent_v)) {
+			lf->write_unlock();
+			return outcome::restart;
+		}
+
+		bool erased = lf->erase(key);
+		lf->write_unlock();
+		return erased ? outcome::done_true : outcome::done_false;
+	}
+
+	template<class F>
+	outcome run(F attempt) {
+		epoch_manager::guard g(epochs);
+		outcome r;
+		while ((r = attempt()) == outcome::restart)
+			std::this_thread::yield();
+		return r;
+	}
+
+public:
+	ConcurrentBTree() {
+		root.store(new leaf());
+	}
+
+	~ConcurrentBTree() {
+		free_rec(root.load());
+	}
+
+	ConcurrentBTree(const ConcurrentBTree &) = delete;
+	ConcurrentBTree& operator=(const ConcurrentBTree &) = delete;
+
+	bool find(const T &key) const {
+		epoch_manager::guard g(epochs);
+		outcome r;
+		while ((r = try_find(key)) == outcome::restart)
+			;
+		return r == outcome::done_true;
+	}
+
+	bool insert(const T &key) {
+		return run([&] { return try_insert(key); }) == outcome::done_true;
+	}
+
+	bool del(const T &key) {
+		return run([&] { return try_erase(key); }) == outcome::done_true;
+	}
+};
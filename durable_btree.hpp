@@ -0,0 +1,320 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "btree.hpp"
+
+// Quando o log e gravado no disco (fsync).
+//
+// every_op: a cada insert/del; nada que retornou se perde.
+// every_batch: a cada batch_ops operacoes (group commit); um crash perde
+// no maximo as ultimas batch_ops - 1.
+// timed: quando passou interval desde o ultimo fsync, conferido a cada
+// operacao (nao ha thread de fundo; commit() forca).
+struct wal_options {
+	enum sync_mode { every_op, every_batch, timed };
+
+	sync_mode sync = every_batch;
+	std::size_t batch_ops = 64;
+	std::chrono::milliseconds interval{10};
+
+	// Faz checkpoint sozinho quando o log passa desse tamanho. E isso que
+	// limita quanto log a recuperacao precisa reaplicar.
+	std::size_t checkpoint_bytes = std::size_t(64) << 20;
+};
+
+// BTree duravel: cada insert/del que muda a arvore vira um registro num
+// log so de append (dir/wal) antes de retornar, e de tempos em tempos a
+// arvore inteira e gravada em dir/checkpoint, zerando o log. Ao abrir, a
+// arvore e montada do checkpoint (bulk_load) e o log e reaplicado por
+// cima; um registro incompleto no fim do log (crash no meio da escrita)
+// e descartado.
+//
+// Reaplicar e idempotente (cada registro so diz se a chave esta ou nao na
+// arvore), entao um crash entre gravar o checkpoint e zerar o log nao
+// estraga nada. T precisa ser trivialmente copiavel.
+template <class T, int o = auto_order<T>(), template<class> class Alloc = slab_pool>
+class DurableBTree {
+	static_assert(std::is_trivially_copyable_v<T>, "DurableBTree grava as chaves byte a byte");
+
+	enum op_code : std::uint8_t { op_insert = 1, op_del = 2 };
+
+	static constexpr std::uint64_t checkpoint_magic = 0x31544e504b434842ull; // "BHCKPNT1"
+	static constexpr std::size_t record_size = 1 + sizeof(T) + sizeof(std::uint32_t);
+
+	BTree<T, o, Alloc> tree;
+	wal_options options;
+
+	std::string dir;
+	int wal_fd = -1;
+	std::size_t wal_bytes = 0;
+
+	std::vector<char> pending;
+	std::size_t pending_ops = 0;
+	std::chrono::steady_clock::time_point last_sync = std::chrono::steady_clock::now();
+
+	[[noreturn]] static void fail(const char* what) {
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+
+	static std::uint32_t checksum(const char* p, std::size_t n) {
+		std::uint32_t h = 2166136261u;
+		for (std::size_t i = 0; i < n; i++) {
+			h ^= (unsigned char)p[i];
+			h *= 16777619u;
+		}
+		return h;
+	}
+
+	std::string path(const char* name) const {
+		return dir + "/" + name;
+	}
+
+	static void write_all(int fd, const char* p, std::size_t n) {
+		while (n) {
+			ssize_t w = ::write(fd, p, n);
+			if (w < 0) {
+				if (errno == EINTR)
+					continue;
+				fail("write");
+			}
+			p += w;
+			n -= w;
+		}
+	}
+
+	static std::vector<char> read_file(int fd) {
+		std::vector<char> data;
+		char buf[1 << 16];
+		while (true) {
+			ssize_t r = ::read(fd, buf, sizeof(buf));
+			if (r < 0) {
+				if (errno == EINTR)
+					continue;
+				fail("read");
+			}
+			if (r == 0)
+				return data;
+			data.insert(data.end(), buf, buf + r);
+		}
+	}
+
+	void fsync_dir() {
+		int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+		if (fd == -1)
+			fail("open");
+		::fsync(fd);
+		::close(fd);
+	}
+
+	void load_checkpoint() {
+		int fd = ::open(path("checkpoint").c_str(), O_RDONLY);
+		if (fd == -1) {
+			if (errno == ENOENT)
+				return;
+			fail("open");
+		}
+
+		std::vector<char> data = read_file(fd);
+		::close(fd);
+
+		std::uint64_t header[3];
+		if (data.size() < sizeof(header))
+			throw std::runtime_error(path("checkpoint") + ": arquivo truncado");
+		std::memcpy(header, data.data(), sizeof(header));
+
+		if (header[0] != checkpoint_magic || header[1] != sizeof(T)
+				|| data.size() != sizeof(header) + header[2] * sizeof(T))
+			throw std::runtime_error(path("checkpoint") + ": checkpoint invalido");
+
+		std::vector<T> keys(header[2]);
+		if (!keys.empty())
+			std::memcpy(keys.data(), data.data() + sizeof(header), keys.size() * sizeof(T));
+		tree.bulk_load(keys.begin(), keys.end());
+	}
+
+	// Reaplica o log e corta o que sobrar depois do ultimo registro valido.
+	void replay_wal() {
+		wal_fd = ::open(path("wal").c_str(), O_RDWR | O_CREAT, 0644);
+		if (wal_fd == -1)
+			fail("open");
+
+		std::vector<char> data = read_file(wal_fd);
+
+		std::size_t pos = 0;
+		for (; pos + record_size <= data.size(); pos += record_size) {
+			const char* r = data.data() + pos;
+
+			std::uint32_t sum;
+			std::memcpy(&sum, r + 1 + sizeof(T), sizeof(sum));
+			if (sum != checksum(r, 1 + sizeof(T)))
+				break;
+
+			T key;
+			std::memcpy(&key, r + 1, sizeof(T));
+			if (r[0] == op_insert)
+				tree.insert(key);
+			else if (r[0] == op_del)
+				tree.del(key);
+			else
+				break;
+		}
+
+		if (pos != data.size()) {
+			if (ftruncate(wal_fd, pos) == -1)
+				fail("ftruncate");
+			::fsync(wal_fd);
+		}
+
+		if (lseek(wal_fd, pos, SEEK_SET) == -1)
+			fail("lseek");
+		wal_bytes = pos;
+	}
+
+	void log(op_code op, const T &key) {
+		char r[record_size];
+		r[0] = op;
+		std::memcpy(r + 1, &key, sizeof(T));
+		std::uint32_t sum = checksum(r, 1 + sizeof(T));
+		std::memcpy(r + 1 + sizeof(T), &sum, sizeof(sum));
+
+		pending.insert(pending.end(), r, r + record_size);
+		pending_ops++;
+
+		bool sync = false;
+		switch (options.sync) {
+		case wal_options::every_op:
+			sync = true;
+			break;
+		case wal_options::every_batch:
+			sync = pending_ops >= options.batch_ops;
+			break;
+		case wal_options::timed:
+			sync = std::chrono::steady_clock::now() - last_sync >= options.interval;
+			break;
+		}
+
+		if (sync)
+			commit();
+
+		if (wal_bytes + pending.size() >= options.checkpoint_bytes)
+			checkpoint();
+	}
+
+public:
+	// Abre (criando se preciso) o indice em dir e recupera o estado gravado.
+	explicit DurableBTree(const std::string &dir, wal_options options = {}) : options(options), dir(dir) {
+		if (::mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST)
+			fail("mkdir");
+
+		load_checkpoint();
+		replay_wal();
+	}
+
+	~DurableBTree() {
+		try {
+			commit();
+		} catch (...) {
+		}
+		::close(wal_fd);
+	}
+
+	DurableBTree(const DurableBTree &) = delete;
+	DurableBTree& operator=(const DurableBTree &) = delete;
+
+	bool find(const T &key) {
+		return tree.find(key);
+	}
+
+	bool insert(const T &key) {
+		if (!tree.insert(key))
+			return false;
+		log(op_insert, key);
+		return true;
+	}
+
+	bool del(const T &key) {
+		if (!tree.del(key))
+			return false;
+		log(op_del, key);
+		return true;
+	}
+
+	// Grava no disco os registros ainda em memoria (um write e um fsync
+	// para todos eles).
+	void commit() {
+		if (!pending.empty()) {
+			write_all(wal_fd, pending.data(), pending.size());
+			if (::fdatasync(wal_fd) == -1)
+				fail("fdatasync");
+
+			wal_bytes += pending.size();
+			pending.clear();
+			pending_ops = 0;
+		}
+		last_sync = std::chrono::steady_clock::now();
+	}
+
+	// Grava a arvore inteira em dir/checkpoint (via arquivo temporario e
+	// rename, entao sempre ha um checkpoint completo) e zera o log.
+	void checkpoint() {
+		std::string tmp = path("checkpoint.tmp");
+		int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd == -1)
+			fail("open");
+
+		std::vector<char> buf;
+		std::uint64_t header[3] = {checkpoint_magic, sizeof(T), 0};
+		buf.resize(sizeof(header));
+
+		for (auto &key : tree) {
+			const char* p = reinterpret_cast<const char*>(&key);
+			buf.insert(buf.end(), p, p + sizeof(T));
+			header[2]++;
+
+			if (buf.size() >= (1 << 20)) {
+				write_all(fd, buf.data(), buf.size());
+				buf.clear();
+			}
+		}
+		write_all(fd, buf.data(), buf.size());
+
+		// O cabecalho (com a contagem) vai por ultimo, no comeco do arquivo.
+		if (pwrite(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header))
+			fail("pwrite");
+		if (::fsync(fd) == -1)
+			fail("fsync");
+		::close(fd);
+
+		if (::rename(tmp.c_str(), path("checkpoint").c_str()) == -1)
+			fail("rename");
+		fsync_dir();
+
+		// O checkpoint ja tem tudo que estava no log e em pending.
+		if (ftruncate(wal_fd, 0) == -1 || lseek(wal_fd, 0, SEEK_SET) == -1)
+			fail("ftruncate");
+		::fsync(wal_fd);
+
+		wal_bytes = 0;
+		pending.clear();
+		pending_ops = 0;
+	}
+
+	// A arvore em memoria, para consultas (iteracao, intervalos, ...).
+	const BTree<T, o, Alloc>& view() const {
+		return tree;
+	}
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "node_search.hpp"
+
+// Chaves por bloco da FrozenBTree: uma linha de cache para tipos
+// aritmeticos (16 int, 8 long), 16 para o resto.
+template<class T>
+constexpr int frozen_block() {
+	if constexpr (std::is_arithmetic_v<T>)
+		return sizeof(T) >= 64 ? 1 : (int)(64 / sizeof(T));
+	else
+		return 16;
+}
+
+// Arvore so de leitura, sem ponteiros, num unico array alinhado: uma
+// arvore B estatica implicita no estilo B+ (S+ tree). O ultimo nivel sao as
+// proprias chaves em ordem, em blocos de B; cada nivel acima tem um bloco
+// por B + 1 blocos do nivel de baixo, guardando a menor chave de cada filho
+// a partir do segundo. O filho i do bloco k e o bloco k * (B + 1) + i do
+// nivel de baixo, entao a descida so faz contas e um count_less (SIMD, sem
+// desvios) por nivel, sempre sobre B chaves: os blocos incompletos sao
+// completados com a maior chave. Os niveis ficam de cima para baixo, e os
+// de cima (pequenos) ficam no cache.
+//
+// Como as folhas sao o array ordenado, lower_bound devolve um ponteiro
+// nele e percorrer um intervalo e andar no array. Montada por
+// BTree::freeze() ou a partir de um intervalo de chaves.
+template<class T, int B = frozen_block<T>()>
+class FrozenBTree {
+	static_assert(B >= 1);
+
+	static constexpr std::size_t align = 64;
+
+	T* data = nullptr;
+	std::size_t capacity = 0;
+	std::size_t count = 0;
+
+	// offset[h]: onde comeca o nivel h (0 sao as folhas) em data.
+	std::vector<std::size_t> offset;
+
+	void release() {
+		if (data) {
+			std::destroy_n(data, capacity);
+			::operator delete(data, std::align_val_t(align));
+		}
+		data = nullptr;
+		capacity = count = 0;
+		offset.clear();
+	}
+
+	// keys precisa estar em ordem e sem repetidos.
+	void build(const std::vector<T> &keys) {
+		count = keys.size();
+		if (count == 0)
+			return;
+
+		std::vector<std::size_t> blocks{(count + B - 1) / B};
+		while (blocks.back() > 1)
+			blocks.push_back((blocks.back() + B) / (B + 1));
+
+		int height = (int)blocks.size();
+		offset.assign(height, 0);
+		for (int h = height - 2; h >= 0; h--)
+			offset[h] = offset[h + 1] + blocks[h + 1] * B;
+		capacity = offset[0] + blocks[0] * B;
+
+		data = static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(align)));
+		std::uninitialized_fill_n(data, capacity, keys.back());
+		std::copy(keys.begin(), keys.end(), data + offset[0]);
+
+		// A menor chave do filho c do nivel h - 1 e a primeira da folha mais
+		// a esquerda dele, a folha c * (B + 1)^(h - 1).
+		std::size_t span = 1;
+		for (int h = 1; h < height; h++) {
+			for (std::size_t j = 0; j < blocks[h]; j++) {
+				for (std::size_t i = 0; i < (std::size_t)B; i++) {
+					std::size_t c = j * (B + 1) + i + 1;
+					if (c < blocks[h - 1])
+						data[offset[h] + j * B + i] = data[offset[0] + c * span * B];
+				}
+			}
+			span *= B + 1;
+		}
+	}
+
+	// Indice da primeira chave >= key (strict) ou > key (!strict).
+	template<bool strict>
+	std::size_t bound(const T &key) const {
+		if (count == 0)
+			return 0;
+
+		// Depois disso os blocos completados com a maior chave nunca a
+		// contam, e a descida nao sai dos blocos que existem.
+		const T &max = data[offset[0] + count - 1];
+		if (strict ? max < key : !(key < max))
+			return count;
+
+		auto rank = [&](const T* block) {
+			if constexpr (strict)
+				return node_search::count_less(block, B, key);
+			else
+				return node_search::count_less_equal(block, B, key);
+		};
+
+		std::size_t k = 0;
+		for (int h = (int)offset.size() - 1; h > 0; h--)
+			k = k * (B + 1) + rank(data + offset[h] + k * B);
+		return k * B + rank(data + offset[0] + k * B);
+	}
+
+public:
+	using value_type = T;
+	using const_iterator = const T*;
+	using iterator = const_iterator;
+
+	FrozenBTree() = default;
+
+	// Chaves de [first, last); se nao estiverem em ordem sao ordenadas.
+	// Repetidos sao ignorados.
+	template<std::input_iterator It>
+	FrozenBTree(It first, It last) {
+		std::vector<T> keys(first, last);
+		if (!std::is_sorted(keys.begin(), keys.end()))
+			std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		build(keys);
+	}
+
+	FrozenBTree(const FrozenBTree &) = delete;
+	FrozenBTree& operator=(const FrozenBTree &) = delete;
+
+	FrozenBTree(FrozenBTree &&other) noexcept {
+		*this = std::move(other);
+	}
+
+	FrozenBTree& operator=(FrozenBTree &&other) noexcept {
+		if (this != &other) {
+			release();
+			data = std::exchange(other.data, nullptr);
+			capacity = std::exchange(other.capacity, 0);
+			count = std::exchange(other.count, 0);
+			offset = std::move(other.offset);
+			other.offset.clear();
+		}
+		return *this;
+	}
+
+	~FrozenBTree() {
+		release();
+	}
+
+	bool find(const T &key) const {
+		std::size_t i = bound<true>(key);
+		return i < count && begin()[i] == key;
+	}
+
+	const_iterator begin() const { return count ? data + offset[0] : nullptr; }
+	const_iterator end() const { return begin() + count; }
+
+	// Primeira chave >= key / > key (end() se nao houver).
+	const_iterator lower_bound(const T &key) const { return begin() + bound<true>(key); }
+	const_iterator upper_bound(const T &key) const { return begin() + bound<false>(key); }
+
+	// Visita em ordem as chaves em [lo, hi).
+	template<class F>
+	void for_each_in_range(const T &lo, const T &hi, F fn) const {
+		for (auto it = lower_bound(lo); it != end() && *it < hi; ++it)
+			fn(*it);
+	}
+
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	int height() const { return (int)offset.size(); }
+
+	// Bytes do array (folhas, niveis internos e o que completa os blocos).
+	std::size_t memory_usage() const {
+		return capacity * sizeof(T) + offset.capacity() * sizeof(std::size_t);
+	}
+};
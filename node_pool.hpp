@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Politicas de alocacao dos nos da BTree. A arvore recebe a politica como
+// parametro de template (template<class> class Alloc) e so usa:
+//
+//   Node* create(args...)  constroi um no
+//   void destroy(Node*)    destroi um no
+//   void release_all()     libera de uma vez toda a memoria da politica
+//   void adopt(other)      passa para esta os nos (e a memoria) de other,
+//                          que fica vazia; usado quando cada thread aloca
+//                          numa politica propria (parallel_build)
+//   bulk_release           true se release_all() realmente libera os nos
+
+
+// Cada no vai direto para o heap global.
+template<class Node>
+class heap_alloc {
+public:
+	static constexpr bool bulk_release = false;
+
+	template<class... Args>
+	Node* create(Args&&... args) {
+		return new Node(std::forward<Args>(args)...);
+	}
+
+	void destroy(Node* node) {
+		delete node;
+	}
+
+	void release_all() {}
+
+	void adopt(heap_alloc &) {}
+};
+
+
+// Aloca os nos em blocos (slabs) de slab_size nos. Nos destruidos vao para
+// uma free list e sao reaproveitados pelo proximo create(); release_all()
+// devolve todos os slabs de uma vez, sem visitar os nos.
+template<class Node>
+class slab_pool {
+	static constexpr std::size_t slab_size = 64;
+
+	union slot {
+		slot* next_free;
+		alignas(Node) unsigned char storage[sizeof(Node)];
+	};
+
+	std::vector<slot*> slabs;
+	slot* free_list = nullptr;
+	std::size_t used_in_slab = slab_size;
+
+	slot* take_slot() {
+		if (free_list != nullptr) {
+			slot* s = free_list;
+			free_list = s->next_free;
+			return s;
+		}
+
+		if (used_in_slab == slab_size) {
+			slabs.push_back(static_cast<slot*>(
+				::operator new(sizeof(slot) * slab_size, std::align_val_t(alignof(slot)))));
+			used_in_slab = 0;
+		}
+
+		return slabs.back() + used_in_slab++;
+	}
+
+public:
+	static constexpr bool bulk_release = true;
+
+	slab_pool() = default;
+	slab_pool(const slab_pool &) = delete;
+	slab_pool& operator=(const slab_pool &) = delete;
+
+	~slab_pool() {
+		release_all();
+	}
+
+	template<class... Args>
+	Node* create(Args&&... args) {
+		slot* s = take_slot();
+		return ::new (static_cast<void*>(s->storage)) Node(std::forward<Args>(args)...);
+	}
+
+	void destroy(Node* node) {
+		node->~Node();
+
+		slot* s = reinterpret_cast<slot*>(node);
+		s->next_free = free_list;
+		free_list = s;
+	}
+
+	// Os slabs de other vem para o comeco da lista (o ultimo continua sendo
+	// o que esta sendo preenchido) e o que sobrou no ultimo slab de other
+	// vai para a free list.
+	void adopt(slab_pool &other) {
+		if (!other.slabs.empty()) {
+			for (std::size_t i = other.used_in_slab; i < slab_size; i++) {
+				slot* s = other.slabs.back() + i;
+				s->next_free = other.free_list;
+				other.free_list = s;
+			}
+			slabs.insert(slabs.begin(), other.slabs.begin(), other.slabs.end());
+		}
+
+		while (other.free_list != nullptr) {
+			slot* s = other.free_list;
+			other.free_list = s->next_free;
+			s->next_free = free_list;
+			free_list = s;
+		}
+
+		other.slabs.clear();
+		other.used_in_slab = slab_size;
+	}
+
+	// Nao chama destrutores: quem usa garante que os nos ja foram
+	// destruidos ou que Node e trivialmente destrutivel.
+	void release_all() {
+		for (auto slab : slabs)
+			::operator delete(slab, std::align_val_t(alignof(slot)));
+
+		slabs.clear();
+		free_list = nullptr;
+		used_in_slab = slab_size;
+	}
+};
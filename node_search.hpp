@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Busca de uma chave dentro de um no.
+//
+// count_less(keys, n, key)       == lower_bound(keys, keys + n, key) - keys
+// count_less_equal(keys, n, key) == upper_bound(keys, keys + n, key) - keys
+//
+// Para inteiros de 32/64 bits, float e double as chaves do no sao
+// comparadas em bloco com instrucoes vetoriais e o resultado sai do
+// popcount da mascara, sem desvios dependentes dos dados. O kernel e
+// escolhido em tempo de compilacao: AVX2 quando disponivel (-mavx2 ou
+// -march=native), senao SSE2 (e SSE4.2 para inteiros de 64 bits). Os
+// demais tipos aritmeticos usam uma contagem linear sem desvios e os
+// tipos nao aritmeticos continuam no std::lower_bound/upper_bound.
+
+namespace node_search {
+
+template<class T>
+inline int scalar_count_less(const T *keys, int n, const T &key) {
+	int c = 0;
+	for (int i = 0; i < n; i++)
+		c += keys[i] < key;
+	return c;
+}
+
+template<class T>
+inline int scalar_count_less_equal(const T *keys, int n, const T &key) {
+	int c = 0;
+	for (int i = 0; i < n; i++)
+		c += !(key < keys[i]);
+	return c;
+}
+
+#if defined(__SSE2__)
+
+// Inteiros sem sinal sao comparados como com sinal depois de inverter o
+// bit mais significativo.
+template<class T>
+inline constexpr bool is_u32 = std::is_integral_v<T> && std::is_unsigned_v<T> && sizeof(T) == 4;
+template<class T>
+inline constexpr bool is_i32 = std::is_integral_v<T> && std::is_signed_v<T> && sizeof(T) == 4;
+template<class T>
+inline constexpr bool is_u64 = std::is_integral_v<T> && std::is_unsigned_v<T> && sizeof(T) == 8;
+template<class T>
+inline constexpr bool is_i64 = std::is_integral_v<T> && std::is_signed_v<T> && sizeof(T) == 8;
+
+// Quantos elementos de keys[0..n) sao menores que key (strict) ou
+// menores ou iguais (!strict).
+template<bool strict>
+inline int count_i32(const std::int32_t *keys, int n, std::int32_t key, std::int32_t flip) {
+	int c = 0, i = 0;
+#if defined(__AVX2__)
+	const __m256i k8 = _mm256_set1_epi32(key ^ flip);
+	const __m256i f8 = _mm256_set1_epi32(flip);
+	for (; i + 8 <= n; i += 8) {
+		__m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(keys + i)), f8);
+		__m256i m = strict ? _mm256_cmpgt_epi32(k8, v) : _mm256_cmpgt_epi32(v, k8);
+		c += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+	}
+#endif
+	const __m128i k4 = _mm_set1_epi32(key ^ flip);
+	const __m128i f4 = _mm_set1_epi32(flip);
+	for (; i + 4 <= n; i += 4) {
+		__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(keys + i)), f4);
+		__m128i m = strict ? _mm_cmpgt_epi32(k4, v) : _mm_cmpgt_epi32(v, k4);
+		c += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(m)));
+	}
+	for (; i < n; i++)
+		c += strict ? (keys[i] ^ flip) < (key ^ flip) : (keys[i] ^ flip) > (key ^ flip);
+
+	// No caso !strict foram contados os maiores que key.
+	return strict ? c : n - c;
+}
+
+template<bool strict>
+inline int count_i64(const std::int64_t *keys, int n, std::int64_t key, std::int64_t flip) {
+	int c = 0, i = 0;
+#if defined(__AVX2__)
+	const __m256i k4 = _mm256_set1_epi64x(key ^ flip);
+	const __m256i f4 = _mm256_set1_epi64x(flip);
+	for (; i + 4 <= n; i += 4) {
+		__m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(keys + i)), f4);
+		__m256i m = strict ? _mm256_cmpgt_epi64(k4, v) : _mm256_cmpgt_epi64(v, k4);
+		c += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+	}
+#endif
+#if defined(__SSE4_2__)
+	const __m128i k2 = _mm_set1_epi64x(key ^ flip);
+	const __m128i f2 = _mm_set1_epi64x(flip);
+	for (; i + 2 <= n; i += 2) {
+		__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(keys + i)), f2);
+		__m128i m = strict ? _mm_cmpgt_epi64(k2, v) : _mm_cmpgt_epi64(v, k2);
+		c += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(m)));
+	}
+#endif
+	for (; i < n; i++)
+		c += strict ? (keys[i] ^ flip) < (key ^ flip) : (keys[i] ^ flip) > (key ^ flip);
+
+	return strict ? c : n - c;
+}
+
+template<bool strict>
+inline int count_f32(const float *keys, int n, float key) {
+	int c = 0, i = 0;
+#if defined(__AVX2__)
+	const __m256 k8 = _mm256_set1_ps(key);
+	for (; i + 8 <= n; i += 8) {
+		__m256 v = _mm256_loadu_ps(keys + i);
+		__m256 m = strict ? _mm256_cmp_ps(v, k8, _CMP_LT_OQ) : _mm256_cmp_ps(v, k8, _CMP_LE_OQ);
+		c += __builtin_popcount(_mm256_movemask_ps(m));
+	}
+#endif
+	const __m128 k4 = _mm_set1_ps(key);
+	for (; i + 4 <= n; i += 4) {
+		__m128 v = _mm_loadu_ps(keys + i);
+		__m128 m = strict ? _mm_cmplt_ps(v, k4) : _mm_cmple_ps(v, k4);
+		c += __builtin_popcount(_mm_movemask_ps(m));
+	}
+	for (; i < n; i++)
+		c += strict ? keys[i] < key : keys[i] <= key;
+	return c;
+}
+
+template<bool strict>
+inline int count_f64(const double *keys, int n, double key) {
+	int c = 0, i = 0;
+#if defined(__AVX2__)
+	const __m256d k4 = _mm256_set1_pd(key);
+	for (; i + 4 <= n; i += 4) {
+		__m256d v = _mm256_loadu_pd(keys + i);
+		__m256d m = strict ? _mm256_cmp_pd(v, k4, _CMP_LT_OQ) : _mm256_cmp_pd(v, k4, _CMP_LE_OQ);
+		c += __builtin_popcount(_mm256_movemask_pd(m));
+	}
+#endif
+	const __m128d k2 = _mm_set1_pd(key);
+	for (; i + 2 <= n; i += 2) {
+		__m128d v = _mm_loadu_pd(keys + i);
+		__m128d m = strict ? _mm_cmplt_pd(v, k2) : _mm_cmple_pd(v, k2);
+		c += __builtin_popcount(_mm_movemask_pd(m));
+	}
+	for (; i < n; i++)
+		c += strict ? keys[i] < key : keys[i] <= key;
+	return c;
+}
+
+template<bool strict, class T>
+inline int count(const T *keys, int n, T key) {
+	if constexpr (is_i32<T>)
+		return count_i32<strict>((const std::int32_t *)keys, n, key, 0);
+	else if constexpr (is_u32<T>)
+		return count_i32<strict>((const std::int32_t *)keys, n, (std::int32_t)key, INT32_MIN);
+	else if constexpr (is_i64<T>)
+		return count_i64<strict>((const std::int64_t *)keys, n, key, 0);
+	else if constexpr (is_u64<T>)
+		return count_i64<strict>((const std::int64_t *)keys, n, (std::int64_t)key, INT64_MIN);
+	else if constexpr (std::is_same_v<T, float>)
+		return count_f32<strict>(keys, n, key);
+	else if constexpr (std::is_same_v<T, double>)
+		return count_f64<strict>(keys, n, key);
+	else if constexpr (strict)
+		return scalar_count_less(keys, n, key);
+	else
+		return scalar_count_less_equal(keys, n, key);
+}
+
+#endif
+
+template<class T>
+inline int count_less(const T *keys, int n, const T &key) {
+	if constexpr (std::is_arithmetic_v<T>) {
+#if defined(__SSE2__)
+		return count<true>(keys, n, key);
+#else
+		return scalar_count_less(keys, n, key);
+#endif
+	} else {
+		return std::lower_bound(keys, keys + n, key) - keys;
+	}
+}
+
+template<class T>
+inline int count_less_equal(const T *keys, int n, const T &key) {
+	if constexpr (std::is_arithmetic_v<T>) {
+#if defined(__SSE2__)
+		return count<false>(keys, n, key);
+#else
+		return scalar_count_less_equal(keys, n, key);
+#endif
+	} else {
+		return std::upper_bound(keys, keys + n, key) - keys;
+	}
+}
+
+}
@@ -0,0 +1,531 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <string>
+#include <system_error>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "node_search.hpp"
+
+// Cache de paginas de um arquivo mapeado com mmap. O arquivo e mapeado em
+// segmentos de segment_pages paginas, sob demanda; no maximo
+// max_segments ficam mapeados ao mesmo tempo e, passando disso, o segmento
+// usado ha mais tempo (e que nao esta preso por nenhum page_ref) e
+// desmapeado. Assim o indice pode ser maior que a memoria: so os
+// segmentos em uso ocupam espaco de enderecamento, e o kernel cuida de
+// ler e escrever as paginas.
+class page_cache {
+public:
+	static constexpr std::size_t page_size = 4096;
+	static constexpr std::size_t segment_pages = 256;
+	static constexpr std::size_t segment_bytes = page_size * segment_pages;
+
+private:
+	struct segment {
+		char* addr;
+		int pins;
+		std::list<std::uint64_t>::iterator lru_pos;
+	};
+
+	int fd = -1;
+	std::uint64_t file_pages = 0;
+	std::size_t max_segments;
+
+	std::unordered_map<std::uint64_t, segment> mapped;
+	std::list<std::uint64_t> lru;
+
+	[[noreturn]] static void fail(const char* what) {
+		throw std::system_error(errno, std::generic_category(), what);
+	}
+
+	void unmap(std::unordered_map<std::uint64_t, segment>::iterator it) {
+		munmap(it->second.addr, segment_bytes);
+		lru.erase(it->second.lru_pos);
+		mapped.erase(it);
+	}
+
+	void evict_if_full() {
+		if (mapped.size() < max_segments)
+			return;
+
+		for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+			auto m = mapped.find(*it);
+			if (m->second.pins == 0) {
+				unmap(m);
+				return;
+			}
+		}
+		// Todos presos: deixa passar do limite ate algum ser solto.
+	}
+
+	segment& map_segment(std::uint64_t seg) {
+		auto it = mapped.find(seg);
+		if (it != mapped.end()) {
+			lru.splice(lru.begin(), lru, it->second.lru_pos);
+			return it->second;
+		}
+
+		evict_if_full();
+
+		void* addr = mmap(nullptr, segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, seg * segment_bytes);
+		if (addr == MAP_FAILED)
+			fail("mmap");
+
+		lru.push_front(seg);
+		return mapped[seg] = {static_cast<char*>(addr), 0, lru.begin()};
+	}
+
+public:
+	// Mantem o segmento de uma pagina mapeado enquanto existir.
+	class page_ref {
+		friend class page_cache;
+
+		page_cache* cache = nullptr;
+		std::uint64_t seg = 0;
+		char* ptr = nullptr;
+
+		page_ref(page_cache* cache, std::uint64_t seg, char* ptr) : cache(cache), seg(seg), ptr(ptr) {}
+
+	public:
+		page_ref() = default;
+
+		page_ref(page_ref &&other) noexcept
+			: cache(std::exchange(other.cache, nullptr)), seg(other.seg), ptr(other.ptr) {}
+
+		page_ref& operator=(page_ref &&other) noexcept {
+			std::swap(cache, other.cache);
+			std::swap(seg, other.seg);
+			std::swap(ptr, other.ptr);
+			return *this;
+		}
+
+		~page_ref() {
+			if (cache != nullptr)
+				cache->mapped.find(seg)->second.pins--;
+		}
+
+		char* data() const { return ptr; }
+
+		template<class P>
+		P* as() const { return reinterpret_cast<P*>(ptr); }
+	};
+
+	page_cache(const std::string &path, std::size_t max_segments) : max_segments(std::max<std::size_t>(max_segments, 1)) {
+		fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd == -1)
+			fail("open");
+
+		struct stat st;
+		if (fstat(fd, &st) == -1)
+			fail("fstat");
+		file_pages = st.st_size / page_size;
+	}
+
+	~page_cache() {
+		sync();
+		for (auto &[seg, s] : mapped)
+			munmap(s.addr, segment_bytes);
+		::close(fd);
+	}
+
+	page_cache(const page_cache &) = delete;
+	page_cache& operator=(const page_cache &) = delete;
+
+	std::uint64_t pages() const {
+		return file_pages;
+	}
+
+	// Cresce o arquivo (de segmento em segmento) ate ter n paginas.
+	void grow_to(std::uint64_t n) {
+		if (n <= file_pages)
+			return;
+
+		std::uint64_t segs = (n + segment_pages - 1) / segment_pages;
+		if (ftruncate(fd, segs * segment_bytes) == -1)
+			fail("ftruncate");
+		file_pages = segs * segment_pages;
+	}
+
+	page_ref pin(std::uint64_t page) {
+		std::uint64_t seg = page / segment_pages;
+		segment &s = map_segment(seg);
+		s.pins++;
+		return page_ref(this, seg, s.addr + (page % segment_pages) * page_size);
+	}
+
+	void sync() {
+		for (auto &[seg, s] : mapped)
+			msync(s.addr, segment_bytes, MS_SYNC);
+	}
+};
+
+
+// B-tree persistente: cada no e uma pagina de 4 KiB de um arquivo acessado
+// por mmap (via page_cache) e os filhos sao numeros de pagina em vez de
+// ponteiros. Abrir um indice existente so le o cabecalho (pagina 0), sem
+// reinserir nada. Usa o mesmo algoritmo da BTree (chaves em todos os
+// nos, split com 2*o+1 chaves, emprestimo/merge abaixo de o chaves), mas
+// os vizinhos sao achados pelo pai, ja que nao ha ponteiros de irmaos.
+//
+// As paginas sao escritas direto no mapeamento; sync() (e o destrutor)
+// forca a gravacao no disco. Um crash no meio de uma operacao pode deixar
+// o arquivo inconsistente.
+//
+// A ordem padrao e a maior que cabe numa pagina.
+template <class T>
+constexpr int paged_order() {
+	return (int)((page_cache::page_size - 16 - sizeof(std::uint64_t)) / (sizeof(T) + sizeof(std::uint64_t)) - 2) / 2;
+}
+
+template <class T, int o = paged_order<T>()>
+class PagedBTree {
+	static_assert(std::is_trivially_copyable_v<T>, "PagedBTree grava as chaves byte a byte no arquivo");
+	static_assert(o >= 1);
+
+	using page_id = std::uint64_t;
+	using page_ref = page_cache::page_ref;
+
+	static constexpr std::uint64_t magic = 0x3145455254424450ull; // "PDBTREE1"
+
+	struct header {
+		std::uint64_t magic;
+		std::uint64_t page_size;
+		std::uint64_t key_size;
+		std::uint64_t order;
+		page_id root;
+		page_id next_page;
+		page_id free_head;
+		std::uint64_t count;
+	};
+
+	struct node {
+		std::uint32_t count;
+		std::uint32_t is_leaf;
+		T keys[2 * o + 1];
+		page_id next[2 * o + 2];
+
+		int find_contained(const T &key) const {
+			return node_search::count_less(keys, (int)count, key);
+		}
+
+		void insert_key(int pos, const T &key) {
+			std::memmove(keys + pos + 1, keys + pos, (count - pos) * sizeof(T));
+			keys[pos] = key;
+			count++;
+		}
+
+		void erase_key(int pos) {
+			std::memmove(keys + pos, keys + pos + 1, (count - pos - 1) * sizeof(T));
+			count--;
+		}
+
+		// Os filhos sao sempre count + 1; chamar antes de mexer em count.
+		void insert_child(int pos, page_id id) {
+			std::memmove(next + pos + 1, next + pos, (count + 1 - pos) * sizeof(page_id));
+			next[pos] = id;
+		}
+
+		void erase_child(int pos) {
+			std::memmove(next + pos, next + pos + 1, (count - pos) * sizeof(page_id));
+		}
+	};
+
+	static_assert(sizeof(node) <= page_cache::page_size, "ordem grande demais para uma pagina");
+
+	page_cache cache;
+	page_ref header_page;
+
+	header* head() const {
+		return header_page.as<header>();
+	}
+
+	node* get(const page_ref &ref) const {
+		return ref.as<node>();
+	}
+
+	page_ref alloc_page(bool is_leaf, page_id &id) {
+		if (head()->free_head != 0) {
+			id = head()->free_head;
+			page_ref ref = cache.pin(id);
+			head()->free_head = *ref.as<page_id>();
+		} else {
+			id = head()->next_page++;
+			cache.grow_to(id + 1);
+		}
+
+		page_ref ref = cache.pin(id);
+		node* n = get(ref);
+		n->count = 0;
+		n->is_leaf = is_leaf;
+		return ref;
+	}
+
+	void free_page(page_id id) {
+		page_ref ref = cache.pin(id);
+		*ref.as<page_id>() = head()->free_head;
+		head()->free_head = id;
+	}
+
+	struct insert_res {
+		bool inserted;
+		bool split = false;
+		T sep = T();
+		page_id right = 0;
+	};
+
+	insert_res insert_rec(page_id id, const T &key) {
+		page_ref ref = cache.pin(id);
+		node* n = get(ref);
+
+		int pos = n->find_contained(key);
+		if (pos < (int)n->count && n->keys[pos] == key)
+			return {false};
+
+		if (n->is_leaf) {
+			n->insert_key(pos, key);
+		} else {
+			auto res = insert_rec(n->next[pos], key);
+			if (!res.split)
+				return {res.inserted};
+
+			n->insert_child(pos + 1, res.right);
+			n->insert_key(pos, res.sep);
+		}
+
+		if (n->count < 2 * o + 1)
+			return {true};
+
+		// Split: as o chaves de cima vao para a nova pagina, a do meio sobe.
+		page_id right_id;
+		page_ref right_ref = alloc_page(n->is_leaf, right_id);
+		node* r = get(right_ref);
+
+		std::memcpy(r->keys, n->keys + o + 1, o * sizeof(T));
+		if (!n->is_leaf)
+			std::memcpy(r->next, n->next + o + 1, (o + 1) * sizeof(page_id));
+		r->count = o;
+		n->count = o;
+
+		return {true, true, n->keys[o], right_id};
+	}
+
+	// Move uma chave do filho pos - 1 para o filho pos, passando pelo pai.
+	void borrow_from_left(node* parent, int pos, node* child, node* left) {
+		if (!child->is_leaf)
+			child->insert_child(0, left->next[left->count]);
+		child->insert_key(0, parent->keys[pos - 1]);
+		parent->keys[pos - 1] = left->keys[left->count - 1];
+		left->count--;
+	}
+
+	void borrow_from_right(node* parent, int pos, node* child, node* right) {
+		child->keys[child->count] = parent->keys[pos];
+		if (!child->is_leaf)
+			child->next[child->count + 1] = right->next[0];
+		child->count++;
+
+		parent->keys[pos] = right->keys[0];
+		if (!right->is_leaf)
+			right->erase_child(0);
+		right->erase_key(0);
+	}
+
+	// Junta o filho pos + 1 (e a chave pos do pai) no filho pos.
+	void merge(node* parent, int pos, node* left, node* right) {
+		left->keys[left->count] = parent->keys[pos];
+		std::memcpy(left->keys + left->count + 1, right->keys, right->count * sizeof(T));
+		if (!left->is_leaf)
+			std::memcpy(left->next + left->count + 1, right->next, (right->count + 1) * sizeof(page_id));
+		left->count += right->count + 1;
+
+		page_id right_id = parent->next[pos + 1];
+		parent->erase_child(pos + 1);
+		parent->erase_key(pos);
+		free_page(right_id);
+	}
+
+	void fix_child(node* n, int pos) {
+		page_ref child_ref = cache.pin(n->next[pos]);
+		node* child = get(child_ref);
+		if (child->count >= o)
+			return;
+
+		if (pos > 0) {
+			page_ref left_ref = cache.pin(n->next[pos - 1]);
+			node* left = get(left_ref);
+			if (left->count > o) {
+				borrow_from_left(n, pos, child, left);
+				return;
+			}
+		}
+
+		if (pos < (int)n->count) {
+			page_ref right_ref = cache.pin(n->next[pos + 1]);
+			node* right = get(right_ref);
+			if (right->count > o) {
+				borrow_from_right(n, pos, child, right);
+				return;
+			}
+			merge(n, pos, child, right);
+			return;
+		}
+
+		page_ref left_ref = cache.pin(n->next[pos - 1]);
+		merge(n, pos - 1, get(left_ref), child);
+	}
+
+	bool delete_rec(page_id id, T key) {
+		page_ref ref = cache.pin(id);
+		node* n = get(ref);
+
+		int pos = n->find_contained(key);
+		bool found = pos < (int)n->count && n->keys[pos] == key;
+
+		if (n->is_leaf) {
+			if (found)
+				n->erase_key(pos);
+			return found;
+		}
+
+		if (found) {
+			// Troca pelo antecessor e apaga ele da subarvore da esquerda.
+			page_id cur = n->next[pos];
+			while (true) {
+				page_ref r = cache.pin(cur);
+				if (get(r)->is_leaf) {
+					key = get(r)->keys[get(r)->count - 1];
+					break;
+				}
+				cur = get(r)->next[get(r)->count];
+			}
+			n->keys[pos] = key;
+		}
+
+		if (!delete_rec(n->next[pos], key))
+			return false;
+
+		fix_child(n, pos);
+		return true;
+	}
+
+	template<class F>
+	bool range_rec(page_id id, const T &lo, const T &hi, F &fn) {
+		page_ref ref = cache.pin(id);
+		node* n = get(ref);
+
+		for (int i = n->find_contained(lo); i <= (int)n->count; i++) {
+			if (!n->is_leaf && !range_rec(n->next[i], lo, hi, fn))
+				return false;
+			if (i == (int)n->count)
+				break;
+			if (!(n->keys[i] < hi))
+				return false;
+			fn(n->keys[i]);
+		}
+		return true;
+	}
+
+public:
+	// Abre (ou cria, se nao existir) o indice em path. cache_segments e
+	// quantos segmentos de page_cache::segment_bytes podem ficar mapeados.
+	explicit PagedBTree(const std::string &path, std::size_t cache_segments = 64) : cache(path, cache_segments) {
+		bool fresh = cache.pages() == 0;
+		if (fresh)
+			cache.grow_to(1);
+
+		header_page = cache.pin(0);
+
+		if (fresh) {
+			*head() = {magic, page_cache::page_size, sizeof(T), (std::uint64_t)o, 0, 1, 0, 0};
+			page_id root;
+			alloc_page(true, root);
+			head()->root = root;
+			return;
+		}
+
+		if (head()->magic != magic)
+			throw std::runtime_error(path + ": nao e um arquivo de PagedBTree");
+		if (head()->page_size != page_cache::page_size || head()->key_size != sizeof(T) || head()->order != (std::uint64_t)o)
+			throw std::runtime_error(path + ": indice criado com outro tipo de chave ou ordem");
+	}
+
+	PagedBTree(const PagedBTree &) = delete;
+	PagedBTree& operator=(const PagedBTree &) = delete;
+
+	std::size_t size() const {
+		return head()->count;
+	}
+
+	bool find(const T &key) {
+		page_id id = head()->root;
+		while (true) {
+			page_ref ref = cache.pin(id);
+			node* n = get(ref);
+
+			int pos = n->find_contained(key);
+			if (pos < (int)n->count && n->keys[pos] == key)
+				return true;
+			if (n->is_leaf)
+				return false;
+			id = n->next[pos];
+		}
+	}
+
+	bool insert(const T &key) {
+		auto res = insert_rec(head()->root, key);
+
+		if (res.split) {
+			page_id id;
+			page_ref ref = alloc_page(false, id);
+			node* r = get(ref);
+			r->keys[0] = res.sep;
+			r->next[0] = head()->root;
+			r->next[1] = res.right;
+			r->count = 1;
+			head()->root = id;
+		}
+
+		if (res.inserted)
+			head()->count++;
+		return res.inserted;
+	}
+
+	bool del(const T &key) {
+		if (!delete_rec(head()->root, key))
+			return false;
+
+		head()->count--;
+
+		page_ref ref = cache.pin(head()->root);
+		node* r = get(ref);
+		if (r->count == 0 && !r->is_leaf) {
+			page_id old_root = head()->root;
+			head()->root = r->next[0];
+			free_page(old_root);
+		}
+		return true;
+	}
+
+	// Chama fn(key) em ordem para cada chave em [lo, hi).
+	template<class F>
+	void for_each_in_range(const T &lo, const T &hi, F fn) {
+		range_rec(head()->root, lo, hi, fn);
+	}
+
+	void sync() {
+		cache.sync();
+	}
+};
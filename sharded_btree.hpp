@@ -0,0 +1,304 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "btree.hpp"
+
+struct shard_options {
+	// Quantas BTrees; 0 usa uma por core.
+	std::size_t shards = 0;
+
+	// A cada check_every operacoes num shard a carga de todos e conferida.
+	// Se o shard mais carregado passou de imbalance vezes a media, os
+	// pontos de corte sao refeitos (rebalance()). Um rebalanceamento custa
+	// O(n), entao so e feito depois de pelo menos n/2 operacoes desde o
+	// anterior. imbalance = 0 desliga o rebalanceamento automatico.
+	std::uint64_t check_every = 4096;
+	double imbalance = 2.0;
+};
+
+// Varias BTrees, cada uma com uma faixa do espaco de chaves e uma trava
+// propria: escritores em faixas diferentes nao disputam nada, e a vazao de
+// escrita cresce com os cores enquanto a carga estiver espalhada entre as
+// faixas (chaves sempre crescentes continuam caindo todas no ultimo shard).
+//
+// O shard i guarda as chaves em [bounds[i - 1], bounds[i]). Os pontos de
+// corte acompanham a carga: cada shard conta as operacoes que recebe, e
+// rebalance() escolhe cortes novos que dividem entre os shards, por igual,
+// metade a carga observada e metade as chaves, e redistribui as chaves
+// (bulk_load) com todos os shards travados. Sem cortes iniciais tudo
+// comeca no shard 0 e o primeiro rebalanceamento automatico espalha.
+//
+// Os cortes ficam num layout imutavel publicado por um ponteiro atomico.
+// Uma operacao le o layout, trava o shard e confere que o shard ainda e
+// do mesmo layout; se um rebalanceamento passou no meio, tenta de novo.
+// Layouts antigos so sao liberados no destrutor (sao pequenos e so
+// aparecem a cada rebalanceamento).
+template <class T, int o = auto_order<T>(), template<class> class Alloc = slab_pool>
+class ShardedBTree {
+	struct layout {
+		std::uint64_t version;
+		std::vector<T> bounds;
+
+		std::size_t route(const T &key) const {
+			return std::upper_bound(bounds.begin(), bounds.end(), key) - bounds.begin();
+		}
+	};
+
+	struct alignas(64) shard {
+		std::shared_mutex m;
+		BTree<T, o, Alloc> tree;
+		std::uint64_t version = 0;
+
+		// Operacoes desde o ultimo rebalanceamento e chaves na arvore.
+		std::atomic<std::uint64_t> ops{0};
+		std::atomic<std::size_t> keys{0};
+	};
+
+	shard_options options;
+	std::size_t count;
+	std::unique_ptr<shard[]> shards;
+
+	std::atomic<const layout*> current;
+	std::vector<std::unique_ptr<layout>> layouts;
+	std::mutex rebalancing;
+
+	// Trava (com Lock) o shard de key no layout atual e chama fn(shard).
+	// Depois de soltar a trava confere a carga, se for a vez.
+	template<class Lock, class F>
+	auto with_shard(const T &key, F fn) {
+		std::uint64_t ops = 0;
+		auto result = [&] {
+			while (true) {
+				const layout* l = current.load(std::memory_order_acquire);
+				shard &s = shards[l->route(key)];
+				Lock lock(s.m);
+				if (s.version == l->version) {
+					ops = s.ops.fetch_add(1, std::memory_order_relaxed) + 1;
+					return fn(s);
+				}
+			}
+		}();
+
+		if (options.imbalance > 0 && ops % options.check_every == 0)
+			maybe_rebalance();
+		return result;
+	}
+
+	void maybe_rebalance() {
+		std::unique_lock guard(rebalancing, std::try_to_lock);
+		if (!guard)
+			return;
+
+		std::uint64_t total = 0, max = 0;
+		std::size_t keys = 0;
+		for (std::size_t i = 0; i < count; i++) {
+			std::uint64_t ops = shards[i].ops.load(std::memory_order_relaxed);
+			total += ops;
+			max = std::max(max, ops);
+			keys += shards[i].keys.load(std::memory_order_relaxed);
+		}
+
+		if (total < keys / 2)
+			return;
+
+		if (max > options.imbalance * total / count) {
+			redistribute();
+		} else {
+			// Carga equilibrada: comeca a contar uma janela nova.
+			for (std::size_t i = 0; i < count; i++)
+				shards[i].ops.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// Com rebalancing travado.
+	void redistribute() {
+		std::vector<std::unique_lock<std::shared_mutex>> locks;
+		for (std::size_t i = 0; i < count; i++)
+			locks.emplace_back(shards[i].m);
+
+		// As chaves de todos os shards, ja em ordem, e o peso de cada uma:
+		// metade da carga do shard dividida entre as chaves dele, mais
+		// metade dividida por igual entre todas.
+		std::vector<T> keys;
+		std::vector<std::size_t> end(count);
+		std::uint64_t total = 0;
+		for (std::size_t i = 0; i < count; i++) {
+			for (auto &k : shards[i].tree)
+				keys.push_back(k);
+			end[i] = keys.size();
+			total += shards[i].ops.load(std::memory_order_relaxed);
+		}
+
+		if (keys.empty()) {
+			for (std::size_t i = 0; i < count; i++)
+				shards[i].ops.store(0, std::memory_order_relaxed);
+			return;
+		}
+
+		// Peso de cada chave de cada shard (a carga de um shard vazio se
+		// perde) e o total, para os cortes.
+		std::vector<double> weight(count);
+		double all = 0;
+		for (std::size_t i = 0, begin = 0; i < count; begin = end[i++]) {
+			if (begin == end[i])
+				continue;
+			weight[i] = 1.0 / keys.size();
+			if (total)
+				weight[i] = (weight[i] + (double)shards[i].ops.load(std::memory_order_relaxed) / total / (end[i] - begin)) / 2;
+			all += weight[i] * (end[i] - begin);
+		}
+
+		// Um shard novo comeca na chave em que o peso acumulado antes dela
+		// passa de j/count do total.
+		std::vector<std::size_t> cuts{0};
+		auto next = std::make_unique<layout>();
+		double sum = 0;
+		std::size_t j = 1;
+		for (std::size_t i = 0, begin = 0; i < count; begin = end[i++]) {
+			for (std::size_t k = begin; k < end[i]; k++) {
+				if (k > 0 && j < count && sum >= all * j / count) {
+					next->bounds.push_back(keys[k]);
+					cuts.push_back(k);
+					while (j < count && sum >= all * j / count)
+						j++;
+				}
+				sum += weight[i];
+			}
+		}
+		cuts.push_back(keys.size());
+
+		next->version = current.load(std::memory_order_relaxed)->version + 1;
+		for (std::size_t i = 0; i < count; i++) {
+			shard &s = shards[i];
+			if (i + 1 < cuts.size())
+				s.tree.bulk_load(keys.begin() + cuts[i], keys.begin() + cuts[i + 1]);
+			else
+				s.tree.clear();
+			s.keys.store(i + 1 < cuts.size() ? cuts[i + 1] - cuts[i] : 0, std::memory_order_relaxed);
+			s.ops.store(0, std::memory_order_relaxed);
+			s.version = next->version;
+		}
+
+		current.store(next.get(), std::memory_order_release);
+		layouts.push_back(std::move(next));
+	}
+
+public:
+	// split_points (opcional, em ordem, no maximo shards - 1) sao os cortes
+	// iniciais.
+	explicit ShardedBTree(shard_options options = {}, std::vector<T> split_points = {}) : options(options) {
+		count = options.shards ? options.shards : std::max(1u, std::thread::hardware_concurrency());
+		if (this->options.check_every == 0)
+			this->options.check_every = 1;
+
+		if (split_points.size() >= count)
+			throw std::invalid_argument("ShardedBTree: mais pontos de corte que shards");
+		for (std::size_t i = 1; i < split_points.size(); i++)
+			if (!(split_points[i - 1] < split_points[i]))
+				throw std::invalid_argument("ShardedBTree: pontos de corte fora de ordem");
+
+		shards = std::make_unique<shard[]>(count);
+		auto first = std::make_unique<layout>();
+		first->version = 0;
+		first->bounds = std::move(split_points);
+		current.store(first.get());
+		layouts.push_back(std::move(first));
+	}
+
+	ShardedBTree(const ShardedBTree &) = delete;
+	ShardedBTree& operator=(const ShardedBTree &) = delete;
+
+	bool find(const T &key) {
+		return with_shard<std::shared_lock<std::shared_mutex>>(key, [&](shard &s) {
+			return s.tree.contains(key);
+		});
+	}
+
+	bool insert(const T &key) {
+		return with_shard<std::unique_lock<std::shared_mutex>>(key, [&](shard &s) {
+			bool inserted = s.tree.insert(key);
+			if (inserted)
+				s.keys.fetch_add(1, std::memory_order_relaxed);
+			return inserted;
+		});
+	}
+
+	bool del(const T &key) {
+		return with_shard<std::unique_lock<std::shared_mutex>>(key, [&](shard &s) {
+			bool deleted = s.tree.del(key);
+			if (deleted)
+				s.keys.fetch_sub(1, std::memory_order_relaxed);
+			return deleted;
+		});
+	}
+
+	// Chama fn(key) em ordem para as chaves em [lo, hi), um shard de cada
+	// vez, com so esse shard travado para leitura. Cada shard e visto
+	// inteiro de uma vez, mas o intervalo todo nao e uma foto unica: um
+	// escritor pode alterar um shard seguinte antes da varredura chegar
+	// nele. fn nao pode chamar a arvore.
+	template<class F>
+	void for_each_in_range(const T &lo, const T &hi, F fn) {
+		T from = lo;
+		while (from < hi) {
+			const layout* l = current.load(std::memory_order_acquire);
+			std::size_t i = l->route(from);
+			shard &s = shards[i];
+
+			std::shared_lock lock(s.m);
+			if (s.version != l->version)
+				continue;
+
+			// Se um rebalanceamento passar entre dois shards, o proximo
+			// recomeca do corte, com o layout novo.
+			bool last = i == l->bounds.size() || !(l->bounds[i] < hi);
+			s.tree.for_each_in_range(from, last ? hi : l->bounds[i], fn);
+			if (last)
+				return;
+			from = l->bounds[i];
+		}
+	}
+
+	// Refaz os pontos de corte pela carga observada desde o ultimo
+	// rebalanceamento (e pelas chaves) e redistribui as chaves. O(n), com
+	// todos os shards travados.
+	void rebalance() {
+		std::lock_guard guard(rebalancing);
+		redistribute();
+	}
+
+	// Exato quando nenhuma thread esta alterando a arvore.
+	std::size_t size() const {
+		std::size_t n = 0;
+		for (std::size_t i = 0; i < count; i++)
+			n += shards[i].keys.load(std::memory_order_relaxed);
+		return n;
+	}
+
+	std::size_t shard_count() const {
+		return count;
+	}
+
+	// Chaves por shard e os pontos de corte atuais, para acompanhar o
+	// balanceamento.
+	std::vector<std::size_t> shard_sizes() const {
+		std::vector<std::size_t> sizes(count);
+		for (std::size_t i = 0; i < count; i++)
+			sizes[i] = shards[i].keys.load(std::memory_order_relaxed);
+		return sizes;
+	}
+
+	std::vector<T> split_points() const {
+		return current.load(std::memory_order_acquire)->bounds;
+	}
+};
@@ -0,0 +1,477 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "btree.hpp"
+
+// BTree para chaves std::string com compressao de prefixo. Cada no guarda
+// as chaves num buffer so (buf): primeiro o prefixo comum a todas as
+// chaves do no, uma vez, e depois so os sufixos, um atras do outro; ends[i]
+// e onde termina o sufixo i. Em vez de um std::string (e uma alocacao) por
+// chave, cada no tem uma alocacao, e chaves com prefixos longos em comum
+// ocupam so o que as diferencia.
+//
+// A busca compara o prefixo do no uma vez e depois so os sufixos. As
+// operacoes recebem std::string_view, entao buscar nao copia a chave.
+//
+// O algoritmo e o da BTree (chaves em todos os nos, split com 2*o+1
+// chaves, emprestimo/merge abaixo de o), mas sem ponteiros de vizinhos:
+// os irmaos sao achados pelo pai.
+template <int o, template<class> class Alloc = slab_pool>
+class StringBTree {
+private:
+
+	struct Node {
+		bool is_leaf = true;
+		std::uint32_t prefix_len = 0;
+		node_vec<std::uint32_t, 2 * o + 1> ends;
+		std::string buf;
+		node_vec<Node*, 2 * o + 2> next;
+
+		static std::uint32_t common_prefix(std::string_view a, std::string_view b) {
+			std::size_t n = std::min(a.size(), b.size());
+			return std::mismatch(a.begin(), a.begin() + n, b.begin()).first - a.begin();
+		}
+
+		std::size_t size() const {
+			return ends.size();
+		}
+
+		std::string_view prefix() const {
+			return std::string_view(buf).substr(0, prefix_len);
+		}
+
+		std::uint32_t start(std::size_t i) const {
+			return i == 0 ? prefix_len : ends[i - 1];
+		}
+
+		std::string_view suffix(std::size_t i) const {
+			return std::string_view(buf).substr(start(i), ends[i] - start(i));
+		}
+
+		std::string key(std::size_t i) const {
+			std::string k(prefix());
+			k += suffix(i);
+			return k;
+		}
+
+		// <0, 0 ou >0 como key(i).compare(k), sem montar key(i).
+		int compare(std::size_t i, std::string_view k) const {
+			std::string_view p = prefix();
+			std::size_t m = std::min(p.size(), k.size());
+			if (int c = p.substr(0, m).compare(k.substr(0, m)))
+				return c;
+			if (k.size() < p.size())
+				return 1;
+			return suffix(i).compare(k.substr(p.size()));
+		}
+
+		// Primeira posicao com chave >= k; found diz se ela e igual a k.
+		int lower_bound(std::string_view k, bool &found) const {
+			found = false;
+
+			// k fora do prefixo fica antes ou depois de todas as chaves.
+			std::string_view p = prefix();
+			std::size_t m = std::min(p.size(), k.size());
+			int c = p.substr(0, m).compare(k.substr(0, m));
+			if (c > 0 || (c == 0 && k.size() < p.size()))
+				return 0;
+			if (c < 0)
+				return (int)size();
+
+			k.remove_prefix(p.size());
+			int lo = 0, hi = (int)size();
+			while (lo < hi) {
+				int mid = (lo + hi) / 2;
+				if (suffix(mid) < k)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+
+			found = lo < (int)size() && suffix(lo) == k;
+			return lo;
+		}
+
+		// Diminui o prefixo para np bytes: o que sai dele volta para o
+		// comeco de cada sufixo.
+		void shrink_prefix(std::uint32_t np) {
+			std::string_view tail = prefix().substr(np);
+
+			std::string nb(buf, 0, np);
+			nb.reserve(buf.size() + tail.size() * size());
+			std::uint32_t from = prefix_len;
+			for (std::size_t i = 0; i < size(); i++) {
+				nb += tail;
+				nb.append(buf, from, ends[i] - from);
+				from = ends[i];
+				ends[i] = nb.size();
+			}
+
+			buf = std::move(nb);
+			prefix_len = np;
+		}
+
+		void insert_key(int pos, std::string_view k) {
+			// Num no vazio a chave inteira vira o prefixo.
+			if (size() == 0) {
+				buf.assign(k);
+				prefix_len = k.size();
+				ends.push_back(buf.size());
+				return;
+			}
+
+			if (k.substr(0, prefix_len) != prefix())
+				shrink_prefix(common_prefix(prefix(), k));
+
+			std::string_view s = k.substr(prefix_len);
+			std::uint32_t at = start(pos);
+			buf.insert(at, s);
+			ends.insert(ends.begin() + pos, at);
+			for (std::size_t i = pos; i < size(); i++)
+				ends[i] += s.size();
+		}
+
+		// O prefixo continua valido (so pode ter ficado mais curto que o
+		// maximo); assign() volta a aperta-lo.
+		void erase_key(int pos) {
+			std::uint32_t b = start(pos), len = ends[pos] - b;
+			buf.erase(b, len);
+			ends.erase(ends.begin() + pos);
+			for (std::size_t i = pos; i < size(); i++)
+				ends[i] -= len;
+		}
+
+		void replace_key(int pos, std::string_view k) {
+			erase_key(pos);
+			insert_key(pos, k);
+		}
+
+		// Troca todas as chaves por keys (em ordem). Como estao em ordem, o
+		// prefixo comum de todas e o da primeira com a ultima.
+		void assign(const std::vector<std::string> &keys) {
+			ends.clear();
+			prefix_len = keys.empty() ? 0 : common_prefix(keys.front(), keys.back());
+			buf.assign(keys.empty() ? std::string_view() : std::string_view(keys.front()).substr(0, prefix_len));
+
+			for (auto &k : keys) {
+				buf.append(k, prefix_len);
+				ends.push_back(buf.size());
+			}
+		}
+
+		void keys_into(std::vector<std::string> &out, std::size_t first, std::size_t last) const {
+			for (std::size_t i = first; i < last; i++)
+				out.push_back(key(i));
+		}
+	};
+
+	Alloc<Node> alloc;
+	Node* root = nullptr;
+	std::size_t count = 0;
+
+	struct insert_rec_res {
+		bool inserted;
+		bool split = false;
+		std::string sep;
+		Node* right = nullptr;
+	};
+
+	insert_rec_res insert_rec(Node* node, std::string_view key) {
+		bool found;
+		int pos = node->lower_bound(key, found);
+		if (found)
+			return {false};
+
+		if (node->is_leaf) {
+			node->insert_key(pos, key);
+		} else {
+			auto res = insert_rec(node->next[pos], key);
+			if (!res.split)
+				return {res.inserted};
+
+			node->insert_key(pos, res.sep);
+			node->next.insert(node->next.begin() + pos + 1, res.right);
+		}
+
+		if (node->size() < 2 * o + 1)
+			return {true};
+
+		// Split: as o chaves de cima vao para o novo no, a do meio sobe.
+		// As duas metades sao remontadas para apertar o prefixo.
+		std::vector<std::string> keys;
+		keys.reserve(2 * o + 1);
+		node->keys_into(keys, 0, node->size());
+
+		std::string sep = keys[o];
+
+		Node* right = alloc.create();
+		right->is_leaf = node->is_leaf;
+		right->assign(std::vector<std::string>(keys.begin() + o + 1, keys.end()));
+		keys.resize(o);
+		node->assign(keys);
+
+		if (!node->is_leaf) {
+			for (std::size_t i = o + 1; i < node->next.size(); i++)
+				right->next.push_back(node->next[i]);
+			while (node->next.size() > o + 1)
+				node->next.pop_back();
+		}
+
+		return {true, true, std::move(sep), right};
+	}
+
+	// Move uma chave do filho pos - 1 para o filho pos, passando pelo pai.
+	void borrow_from_left(Node* node, int pos) {
+		Node* child = node->next[pos];
+		Node* left = node->next[pos - 1];
+
+		child->insert_key(0, node->key(pos - 1));
+		node->replace_key(pos - 1, left->key(left->size() - 1));
+		left->erase_key(left->size() - 1);
+
+		if (!child->is_leaf) {
+			child->next.insert(child->next.begin(), left->next.back());
+			left->next.pop_back();
+		}
+	}
+
+	void borrow_from_right(Node* node, int pos) {
+		Node* child = node->next[pos];
+		Node* right = node->next[pos + 1];
+
+		child->insert_key(child->size(), node->key(pos));
+		node->replace_key(pos, right->key(0));
+		right->erase_key(0);
+
+		if (!child->is_leaf) {
+			child->next.push_back(right->next.front());
+			right->next.erase(right->next.begin());
+		}
+	}
+
+	// Junta o filho pos + 1 (e a chave pos do pai) no filho pos.
+	void merge(Node* node, int pos) {
+		Node* left = node->next[pos];
+		Node* right = node->next[pos + 1];
+
+		std::vector<std::string> keys;
+		keys.reserve(2 * o + 1);
+		left->keys_into(keys, 0, left->size());
+		keys.push_back(node->key(pos));
+		right->keys_into(keys, 0, right->size());
+		left->assign(keys);
+
+		for (auto child : right->next)
+			left->next.push_back(child);
+
+		node->erase_key(pos);
+		node->next.erase(node->next.begin() + pos + 1);
+		alloc.destroy(right);
+	}
+
+	void fix_child(Node* node, int pos) {
+		if (node->next[pos]->size() >= o)
+			return;
+
+		if (pos > 0 && node->next[pos - 1]->size() > o)
+			borrow_from_left(node, pos);
+		else if (pos < (int)node->size() && node->next[pos + 1]->size() > o)
+			borrow_from_right(node, pos);
+		else if (pos < (int)node->size())
+			merge(node, pos);
+		else
+			merge(node, pos - 1);
+	}
+
+	bool delete_rec(Node* node, std::string_view key) {
+		bool found;
+		int pos = node->lower_bound(key, found);
+
+		if (node->is_leaf) {
+			if (found)
+				node->erase_key(pos);
+			return found;
+		}
+
+		if (!found) {
+			if (!delete_rec(node->next[pos], key))
+				return false;
+			fix_child(node, pos);
+			return true;
+		}
+
+		// Troca pelo antecessor e apaga ele da subarvore da esquerda.
+		Node* n = node->next[pos];
+		while (!n->is_leaf)
+			n = n->next.back();
+
+		std::string pred = n->key(n->size() - 1);
+		node->replace_key(pos, pred);
+
+		delete_rec(node->next[pos], pred);
+		fix_child(node, pos);
+		return true;
+	}
+
+	// Visita em ordem as chaves de node em [lo, hi). scratch guarda a chave
+	// montada (prefixo + sufixo) que e passada para fn.
+	template<class F>
+	bool range_rec(const Node* node, std::string_view lo, std::string_view hi, F &fn, std::string &scratch) const {
+		bool found;
+		int i = node->lower_bound(lo, found);
+
+		for (; i <= (int)node->size(); i++) {
+			if (!node->is_leaf && !range_rec(node->next[i], lo, hi, fn, scratch))
+				return false;
+
+			if (i == (int)node->size())
+				break;
+			if (node->compare(i, hi) >= 0)
+				return false;
+
+			scratch.assign(node->prefix());
+			scratch += node->suffix(i);
+			fn(std::string_view(scratch));
+		}
+
+		return true;
+	}
+
+	template<class F>
+	void each_rec(const Node* node, F &fn, std::string &scratch) const {
+		for (std::size_t i = 0; i <= node->size(); i++) {
+			if (!node->is_leaf)
+				each_rec(node->next[i], fn, scratch);
+			if (i == node->size())
+				break;
+
+			scratch.assign(node->prefix());
+			scratch += node->suffix(i);
+			fn(std::string_view(scratch));
+		}
+	}
+
+	std::size_t memory_rec(const Node* node) const {
+		std::size_t total = sizeof(Node) + node->buf.capacity();
+		for (auto child : node->next)
+			total += memory_rec(child);
+		return total;
+	}
+
+	void print_rec(const Node* node, int depth = 0) const {
+		std::cout << std::string(depth * 3, ' ');
+		if (depth > 0) std::cout << "└─";
+
+		std::cout << "(" << node->prefix() << ")[";
+		for (std::size_t i = 0; i < node->size(); ++i) {
+			std::cout << node->suffix(i);
+			if (i + 1 < node->size()) std::cout << "|";
+		}
+		std::cout << "]" << std::endl;
+
+		for (auto child : node->next)
+			print_rec(child, depth + 1);
+	}
+
+	void clear_rec(Node* node) {
+		for (auto child : node->next)
+			clear_rec(child);
+		alloc.destroy(node);
+	}
+
+public:
+	StringBTree() {
+		root = alloc.create();
+	}
+
+	~StringBTree() {
+		clear_rec(root);
+	}
+
+	StringBTree(const StringBTree &) = delete;
+	StringBTree& operator=(const StringBTree &) = delete;
+
+	std::size_t size() const {
+		return count;
+	}
+
+	void clear() {
+		clear_rec(root);
+		root = alloc.create();
+		count = 0;
+	}
+
+	bool find(std::string_view key) const {
+		const Node* node = root;
+		while (true) {
+			bool found;
+			int pos = node->lower_bound(key, found);
+			if (found)
+				return true;
+			if (node->is_leaf)
+				return false;
+			node = node->next[pos];
+		}
+	}
+
+	bool insert(std::string_view key) {
+		auto res = insert_rec(root, key);
+
+		if (res.split) {
+			Node* new_root = alloc.create();
+			new_root->is_leaf = false;
+			new_root->insert_key(0, res.sep);
+			new_root->next.push_back(root);
+			new_root->next.push_back(res.right);
+			root = new_root;
+		}
+
+		count += res.inserted;
+		return res.inserted;
+	}
+
+	bool del(std::string_view key) {
+		if (!delete_rec(root, key))
+			return false;
+
+		count--;
+
+		if (root->size() == 0 && !root->is_leaf) {
+			Node* old_root = root;
+			root = root->next.front();
+			alloc.destroy(old_root);
+		}
+		return true;
+	}
+
+	// Chama fn(std::string_view) em ordem para cada chave em [lo, hi). A
+	// view so vale durante a chamada.
+	template<class F>
+	void for_each_in_range(std::string_view lo, std::string_view hi, F fn) const {
+		std::string scratch;
+		range_rec(root, lo, hi, fn, scratch);
+	}
+
+	// Chama fn(std::string_view) em ordem para todas as chaves.
+	template<class F>
+	void for_each(F fn) const {
+		std::string scratch;
+		each_rec(root, fn, scratch);
+	}
+
+	// Bytes usados pelos nos e seus buffers.
+	std::size_t memory_usage() const {
+		return memory_rec(root);
+	}
+
+	void print() const {
+		print_rec(root);
+	}
+};
@@ -0,0 +1,93 @@
+// Leitores procuram chaves que estao sempre na ConcurrentBTree enquanto
+// escritores inserem e apagam outras chaves entre elas, forcando splits o
+// tempo todo: nenhum find de chave presente pode voltar false.
+//
+//   $ ./test_concurrent_btree
+
+#include "../concurrent_btree.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+int main() {
+	constexpr long n = 4096, gap = 1024;
+	constexpr int readers = 4, writers = 4;
+	constexpr auto duration = std::chrono::seconds(2);
+
+	// Ordem pequena: poucas chaves por no, muitos splits.
+	ConcurrentBTree<long, 2> t;
+
+	// Os multiplos de gap ficam na arvore o tempo todo.
+	for (long p = 0; p < n; p++)
+		t.insert(p * gap);
+
+	std::atomic<bool> stop{false};
+	std::atomic<long> misses{0}, lookups{0};
+	std::vector<std::thread> threads;
+
+	for (int r = 0; r < readers; r++) {
+		threads.emplace_back([&, r] {
+			std::mt19937_64 rng(r + 1);
+			long local = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				long k = (long)(rng() % n) * gap;
+				if (!t.find(k) && misses.fetch_add(1) == 0)
+					std::fprintf(stderr, "find(%ld) = false com a chave na arvore\n", k);
+				local++;
+			}
+			lookups.fetch_add(local);
+		});
+	}
+
+	// Escritores inserem chaves novas entre os multiplos de gap, em pontos
+	// ao acaso (duas para cada uma que apagam, para os nos continuarem
+	// enchendo e dividindo), e apagam so chaves que eles mesmos inseriram.
+	std::atomic<long> wrong{0};
+	std::vector<std::vector<long>> live(writers);
+	for (int w = 0; w < writers; w++) {
+		threads.emplace_back([&, w] {
+			std::mt19937_64 rng(100 + w);
+			auto &mine = live[w];
+			while (!stop.load(std::memory_order_relaxed)) {
+				for (int i = 0; i < 2; i++) {
+					long k = (long)(rng() % n) * gap + 1 + (long)(rng() % (gap - 1));
+					if (t.insert(k))
+						mine.push_back(k);
+				}
+				if (mine.empty())
+					continue;
+
+				std::size_t i = rng() % mine.size();
+				std::swap(mine[i], mine.back());
+				wrong += !t.del(mine.back());
+				mine.pop_back();
+			}
+		});
+	}
+
+	std::this_thread::sleep_for(duration);
+	stop.store(true);
+	for (auto &th : threads)
+		th.join();
+
+	for (long p = 0; p < n; p++)
+		wrong += !t.find(p * gap);
+	for (auto &mine : live)
+		for (auto k : mine)
+			wrong += !t.find(k);
+
+	if (misses.load() || wrong.load()) {
+		std::fprintf(stderr, "%ld falsos negativos em %ld buscas, %ld operacoes erradas\n",
+			misses.load(), lookups.load(), wrong.load());
+		return 1;
+	}
+
+	std::printf("ok: %ld buscas\n", lookups.load());
+	return 0;
+}